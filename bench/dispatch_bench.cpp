@@ -0,0 +1,98 @@
+// 事件分发基准：主循环每个事件按 fd 找到连接、刷新定时器、读 fd/关闭标志/文件写出位置的耗时
+// 对照冷热分离之前的布局：fd 到连接对象的 unordered_map，热字段分散在约 864 字节的连接对象里
+// 用法：bench_dispatch [连接数=100000] [事件数=20000000]
+#include "timingwheel.h"
+#include "httpconnection.h"
+#include "objectpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using SteadyClock = std::chrono::steady_clock;
+
+static const int KEEP_ALIVE_MS = 60000;
+
+// 冷热分离之前的连接对象：分发用到的字段与缓冲区、请求、响应交错排列，分布在多个缓存行上
+struct LegacyConn {
+    int fd;
+    sockaddr_in addr;
+    bool is_close;
+    char buffers[96];       // 读写缓冲区
+    iovec file_iov;         // 文件写出位置
+    char request[640];      // 请求、响应对象
+    TimerNode timer;
+    char tail[56];
+};
+
+static double NsPerEvent(SteadyClock::time_point begin, size_t events) {
+    return std::chrono::duration<double, std::nano>(SteadyClock::now() - begin).count() / events;
+}
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? atoi(argv[1]) : 100000;
+    const size_t eventCount = argc > 2 ? strtoul(argv[2], nullptr, 10) : 20000000;
+    const int firstFd = 10;
+    std::mt19937 rng(1);
+    std::vector<int> events(eventCount);
+    for (auto& fd : events) fd = firstFd + rng() % n;
+    volatile long sink = 0;
+
+    printf("连接数：%d，事件数：%zu，LegacyConn %zuB，HttpConnHot %zuB\n", n, eventCount, sizeof(LegacyConn), sizeof(HttpConnHot));
+    for (int round = 0; round < 3; round++) {
+        double legacyNs, hotNs;
+        {
+            TimingWheel wheel(10);
+            ObjectPool<LegacyConn> pool(n, 512);
+            std::unordered_map<int, LegacyConn*> users;
+            std::vector<int> order(n);
+            for (int i = 0; i < n; i++) order[i] = firstFd + i;
+            std::shuffle(order.begin(), order.end(), rng);  // 连接按任意顺序建立，对象在池中的位置与 fd 无关
+            for (int fd : order) {
+                LegacyConn* conn = pool.New();
+                conn->fd = fd;
+                conn->is_close = false;
+                conn->file_iov = { nullptr, 0 };
+                conn->timer = TimerNode();
+                conn->timer.data = conn;
+                users[fd] = conn;
+                wheel.add(&conn->timer, KEEP_ALIVE_MS);
+            }
+            auto begin = SteadyClock::now();
+            for (int fd : events) {
+                LegacyConn* conn = users[fd];
+                wheel.adjust(&conn->timer, KEEP_ALIVE_MS);
+                sink += conn->fd + conn->is_close + conn->file_iov.iov_len;
+            }
+            legacyNs = NsPerEvent(begin, eventCount);
+            for (auto& item : users) wheel.del(&item.second->timer);
+        }
+        {
+            TimingWheel wheel(10);
+            std::vector<HttpConnHot> conns(firstFd + n);
+            for (int fd = firstFd; fd < firstFd + n; fd++) {
+                HttpConnHot* hot = &conns[fd];
+                hot->fd = fd;
+                hot->is_close = false;
+                hot->file_iov = { nullptr, 0 };
+                hot->conn = nullptr;
+                hot->timer.data = hot;
+                wheel.add(&hot->timer, KEEP_ALIVE_MS);
+            }
+            auto begin = SteadyClock::now();
+            for (int fd : events) {
+                HttpConnHot* hot = &conns[fd];
+                wheel.adjust(&hot->timer, KEEP_ALIVE_MS);
+                sink += hot->fd + hot->is_close + hot->file_iov.iov_len;
+            }
+            hotNs = NsPerEvent(begin, eventCount);
+            for (int fd = firstFd; fd < firstFd + n; fd++) wheel.del(&conns[fd].timer);
+        }
+        printf("第 %d 轮：map + LegacyConn %.1f ns/事件，fd 下标 HttpConnHot 数组 %.1f ns/事件\n", round + 1, legacyNs, hotNs);
+    }
+    return 0;
+}
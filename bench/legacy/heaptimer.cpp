@@ -1,13 +1,12 @@
-#include "../include/heaptimer.h"
+#include "heaptimer.h"
 
 void HeapTimer::siftup(size_t i) {
-    assert(i >= 0 && i < _heap.size());
-    size_t j = (i - 1) / 2;
-    while (j >= 0) {
+    assert(i < _heap.size());
+    while (i > 0) {
+        size_t j = (i - 1) / 2;
         if (_heap[j] < _heap[i]) { break; } // 上浮直到父节点小于等于子节点
         SwapNode(i, j); // 交换节点
         i = j;
-        j = (i - 1) / 2;
     }
 }
 
@@ -61,7 +60,7 @@ void HeapTimer::doWork(int id) {
         return;
     }
     size_t i = _ref[id];
-    TimerNode node = _heap[i];
+    HeapTimerNode node = _heap[i];
     node.cb(); // 执行回调函数
     del(i); // 移除定时器
 }
@@ -97,7 +96,7 @@ void HeapTimer::tick() {
         return;
     }
     while (!_heap.empty()) {
-        TimerNode node = _heap.front();
+        HeapTimerNode node = _heap.front();
         if (std::chrono::duration_cast<MS>(node.expires - Clock::now()).count() > 0) {
             break;
         }
@@ -1,42 +1,32 @@
-//#ifndef HEAP_TIMER_H
-//#define HEAP_TIMER_H
+#ifndef LEGACY_HEAP_TIMER_H
+#define LEGACY_HEAP_TIMER_H
 
-#pragma once
-
-
-#include <queue>
+#include <vector>
 #include <unordered_map>
-#include <time.h>
-#include <algorithm>
-#include <arpa/inet.h> 
-#include <functional> 
-#include <assert.h> 
+#include <functional>
 #include <chrono>
-#include "log.h"
+#include <assert.h>
+
+// 换成分层时间轮之前的小根堆定时器，只作为基准测试的对照；
+// 节点类型改名为 HeapTimerNode（与时间轮的 TimerNode 区分），siftup 到堆顶时的越界已修正，其余与原实现相同
 
- // 超时回调函数类型
 typedef std::function<void()> TimeoutCallBack;
-// Clock 为 std::chrono 中的高分辨率时钟类型，用于测量时间间隔
 typedef std::chrono::high_resolution_clock Clock;
-// MS 为毫秒的时间间隔，用于表示一段时间
 typedef std::chrono::milliseconds MS;
-// TimeStamp 为 Clock::time_point 类型，用于表示时间点
 typedef Clock::time_point TimeStamp;
 
-// 定义定时器节点结构体
-struct TimerNode {
+struct HeapTimerNode {
     int id;
     TimeStamp expires;                      // 定时器到期时间点
     TimeoutCallBack cb;                     // 定时器回调函数
-    bool operator < (const TimerNode& t) {
+    bool operator < (const HeapTimerNode& t) {
         return expires < t.expires;
     }
-    bool operator > (const TimerNode& t) {
+    bool operator > (const HeapTimerNode& t) {
         return expires > t.expires;
     }
 };
 
-// 定时器类
 class HeapTimer {
 public:
     HeapTimer() { _heap.reserve(64); }
@@ -57,6 +47,8 @@ public:
 
     int GetNextTick();                                          // 获取下一个定时器到期的时间
 
+    size_t size() const { return _heap.size(); }
+
 private:
     void del(size_t i);                                        // 移除指定位置的定时器
 
@@ -66,10 +58,9 @@ private:
 
     void SwapNode(size_t i, size_t j);                         // 交换两个节点的位置
 
-    std::vector<TimerNode> _heap;                               // 存储定时器节点的堆
+    std::vector<HeapTimerNode> _heap;                           // 存储定时器节点的堆
 
     std::unordered_map<int, size_t> _ref;                       // 存储定时器节点id和在堆中的位置映射
 };
 
-//#endif 
-
+#endif
@@ -0,0 +1,65 @@
+#ifndef QUEUE_THREAD_POOL_H
+#define QUEUE_THREAD_POOL_H
+
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <assert.h>
+
+// 换成工作窃取调度之前的线程池：一个 std::queue 加一把锁和一个条件变量，
+// 只作为基准测试的对照，除类名外与原实现相同
+class QueueThreadPool {
+public:
+    explicit QueueThreadPool(size_t threadCount = 8): _pool(std::make_shared<Pool>()) {
+            assert(threadCount > 0);
+            for(size_t i = 0; i < threadCount; i++) {
+                std::thread([pool = _pool] {
+                    std::unique_lock<std::mutex> locker(pool->mtx);
+                    while(true) {
+                        if(!pool->tasks.empty()) {
+                            auto task = std::move(pool->tasks.front());
+                            pool->tasks.pop();
+                            locker.unlock();
+                            task();
+                            locker.lock();
+                        } 
+                        else if(pool->isClosed) break;
+                        else pool->cond.wait(locker);
+                    }
+                }).detach();
+            }
+    }
+
+    ~QueueThreadPool() {
+        if(static_cast<bool>(_pool)) {
+            {
+                std::lock_guard<std::mutex> locker(_pool->mtx);
+                _pool->isClosed = true;
+            }
+            _pool->cond.notify_all();
+        }
+    }
+
+    template<class F>
+    void AddTask(F&& task) {
+        {
+            std::lock_guard<std::mutex> locker(_pool->mtx);
+            _pool->tasks.emplace(std::forward<F>(task));
+        }
+        _pool->cond.notify_one();
+    }
+
+private:
+    struct Pool {
+        std::mutex mtx;
+        std::condition_variable cond;
+        bool isClosed = false;
+        std::queue<std::function<void()>> tasks;
+    };
+    std::shared_ptr<Pool> _pool;
+};
+
+#endif
@@ -0,0 +1,92 @@
+// 线程池吞吐基准：一个线程（相当于主循环）连续提交任务，统计全部执行完的每秒任务数
+// 对照换成工作窃取调度之前的单队列线程池（legacy/queuethreadpool.h）
+// 用法：bench_threadpool [任务数=1000000] [每个任务的工作量 ns=0] [线程数列表=4,8,16,32,64]
+// 线程数超过 CPU 数时测到的是超额订阅下的表现，比较不同线程数时应在核数足够的机器上运行
+#include "threadpool.h"
+#include "legacy/queuethreadpool.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<size_t> g_done(0);
+
+// 模拟每个任务的处理时间
+static void Work(int ns) {
+    if (ns <= 0) return;
+    auto end = Clock::now() + std::chrono::nanoseconds(ns);
+    while (Clock::now() < end) {}
+}
+
+// 提交 tasks 个任务并等待全部完成，返回每秒任务数
+template<class Pool>
+static double Run(Pool& pool, size_t tasks, int workNs) {
+    g_done.store(0);
+    auto begin = Clock::now();
+    for (size_t i = 0; i < tasks; i++) {
+        pool.AddTask([workNs] {
+            Work(workNs);
+            g_done.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+    while (g_done.load(std::memory_order_relaxed) < tasks) {
+        std::this_thread::yield();
+    }
+    double sec = std::chrono::duration<double>(Clock::now() - begin).count();
+    return tasks / sec;
+}
+
+// 跑 rounds 轮取中位数
+template<class Pool>
+static double Median(Pool& pool, size_t tasks, int workNs, int rounds) {
+    std::vector<double> res;
+    for (int i = 0; i < rounds; i++) {
+        res.push_back(Run(pool, tasks, workNs));
+    }
+    std::sort(res.begin(), res.end());
+    return res[res.size() / 2];
+}
+
+static std::vector<size_t> ParseList(const char* str) {
+    std::vector<size_t> res;
+    std::string s(str);
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) end = s.size();
+        size_t n = strtoul(s.c_str() + pos, nullptr, 10);
+        if (n > 0) res.push_back(n);
+        pos = end + 1;
+    }
+    return res;
+}
+
+int main(int argc, char** argv) {
+    size_t tasks = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    int workNs = argc > 2 ? atoi(argv[2]) : 0;
+    std::vector<size_t> threads = ParseList(argc > 3 ? argv[3] : "4,8,16,32,64");
+    const int rounds = 3;
+
+    printf("任务数：%zu，每个任务工作量：%dns，CPU 数：%u，每项取 %d 轮中位数\n",
+        tasks, workNs, std::thread::hardware_concurrency(), rounds);
+    printf("%8s %18s %18s %8s\n", "threads", "queue(tasks/s)", "stealing(tasks/s)", "ratio");
+    for (size_t n : threads) {
+        double oldRate, newRate;
+        {
+            QueueThreadPool pool(n);
+            oldRate = Median(pool, tasks, workNs, rounds);
+        }
+        {
+            ThreadPool pool(n, 65536);
+            newRate = Median(pool, tasks, workNs, rounds);
+        }
+        printf("%8zu %18.0f %18.0f %8.2f\n", n, oldRate, newRate, newRate / oldRate);
+    }
+    return 0;
+}
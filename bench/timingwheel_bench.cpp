@@ -0,0 +1,148 @@
+// 定时器基准：分层时间轮与原小根堆定时器（legacy/heaptimer.h）的添加、刷新、到期处理耗时
+// 用法：bench_timingwheel [定时器数量列表=10000,100000,1000000]
+// add    ：空定时器中逐个添加 N 个定时器（超时 1~60s 随机）
+// adjust ：N 个定时器中随机刷新 max(N, 1000000) 次，超时固定 60s（相当于连接每次读写刷新超时）
+// tick   ：N 个定时器的超时均匀分布在 1s 内，按 10ms 间隔调用 tick 直到全部到期，只统计 tick 内的耗时
+#include "timingwheel.h"
+#include "cachedclock.h"
+#include "legacy/heaptimer.h"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+
+using SteadyClock = std::chrono::steady_clock;
+
+static const int TICK_MS = 10;
+static const int KEEP_ALIVE_MS = 60000;
+
+// 原实现的超时回调是 std::bind(&WebServer::CloseConn, this, client)，这里保持同样的绑定形式
+struct Sink {
+    size_t expired = 0;
+    void Expire(TimerNode*) { expired++; }
+};
+
+static double NsSince(SteadyClock::time_point begin) {
+    return std::chrono::duration<double, std::nano>(SteadyClock::now() - begin).count();
+}
+
+struct Result {
+    double addNs;
+    double adjustNs;
+    double tickNs;
+};
+
+static Result BenchHeap(size_t n, size_t adjusts, uint32_t seed) {
+    Result res;
+    Sink sink;
+    std::vector<TimerNode> owners(n);  // 只作为回调参数，对应原实现回调绑定的连接指针
+    std::mt19937 rng(seed);
+    {
+        HeapTimer heap;
+        auto begin = SteadyClock::now();
+        for (size_t i = 0; i < n; i++) {
+            heap.add(static_cast<int>(i), 1 + rng() % KEEP_ALIVE_MS, std::bind(&Sink::Expire, &sink, &owners[i]));
+        }
+        res.addNs = NsSince(begin) / n;
+
+        std::vector<int> ids(adjusts);
+        for (auto& id : ids) id = rng() % n;
+        begin = SteadyClock::now();
+        for (int id : ids) {
+            heap.adjust(id, KEEP_ALIVE_MS);
+        }
+        res.adjustNs = NsSince(begin) / adjusts;
+    }
+    {
+        HeapTimer heap;
+        for (size_t i = 0; i < n; i++) {
+            heap.add(static_cast<int>(i), 1 + static_cast<int>(i * 1000 / n), std::bind(&Sink::Expire, &sink, &owners[i]));
+        }
+        double tickNs = 0;
+        while (heap.size() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(TICK_MS));
+            auto begin = SteadyClock::now();
+            heap.tick();
+            tickNs += NsSince(begin);
+        }
+        res.tickNs = tickNs / n;
+    }
+    return res;
+}
+
+static Result BenchWheel(size_t n, size_t adjusts, uint32_t seed) {
+    Result res;
+    Sink sink;
+    std::mt19937 rng(seed);
+    CachedClock::Update();  // 与主循环一样由本线程刷新缓存时钟
+    {
+        TimingWheel wheel(TICK_MS);
+        wheel.SetCallBack([&sink](TimerNode* node) { sink.Expire(node); });
+        std::vector<TimerNode> nodes(n);
+        auto begin = SteadyClock::now();
+        for (size_t i = 0; i < n; i++) {
+            wheel.add(&nodes[i], 1 + rng() % KEEP_ALIVE_MS);
+        }
+        res.addNs = NsSince(begin) / n;
+
+        std::vector<int> ids(adjusts);
+        for (auto& id : ids) id = rng() % n;
+        begin = SteadyClock::now();
+        for (int id : ids) {
+            wheel.adjust(&nodes[id], KEEP_ALIVE_MS);
+        }
+        res.adjustNs = NsSince(begin) / adjusts;
+        for (auto& node : nodes) wheel.del(&node);
+    }
+    {
+        TimingWheel wheel(TICK_MS);
+        wheel.SetCallBack([&sink](TimerNode* node) { sink.Expire(node); });
+        std::vector<TimerNode> nodes(n);
+        for (size_t i = 0; i < n; i++) {
+            wheel.add(&nodes[i], 1 + static_cast<int>(i * 1000 / n));
+        }
+        double tickNs = 0;
+        while (wheel.size() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(TICK_MS));
+            CachedClock::Update();
+            auto begin = SteadyClock::now();
+            wheel.tick();
+            tickNs += NsSince(begin);
+        }
+        res.tickNs = tickNs / n;
+    }
+    return res;
+}
+
+static std::vector<size_t> ParseList(const char* str) {
+    std::vector<size_t> res;
+    std::string s(str);
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) end = s.size();
+        size_t n = strtoul(s.c_str() + pos, nullptr, 10);
+        if (n > 0) res.push_back(n);
+        pos = end + 1;
+    }
+    return res;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes = ParseList(argc > 1 ? argv[1] : "10000,100000,1000000");
+    printf("单位：ns/次（tick 为每个到期定时器分摊的耗时）\n");
+    printf("%9s %8s %10s %10s %10s\n", "timers", "timer", "add", "adjust", "tick");
+    for (size_t n : sizes) {
+        size_t adjusts = n > 1000000 ? n : 1000000;
+        Result heap = BenchHeap(n, adjusts, 1);
+        Result wheel = BenchWheel(n, adjusts, 1);
+        printf("%9zu %8s %10.1f %10.1f %10.1f\n", n, "heap", heap.addNs, heap.adjustNs, heap.tickNs);
+        printf("%9zu %8s %10.1f %10.1f %10.1f\n", n, "wheel", wheel.addNs, wheel.adjustNs, wheel.tickNs);
+    }
+    return 0;
+}
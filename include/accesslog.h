@@ -0,0 +1,83 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <stdint.h>
+
+#include "log.h"
+
+// 访问日志
+// 每个请求一行，字段以制表符分隔：时间 客户端IP 方法 路径 状态码 响应字节数 耗时(ms)
+// 工作线程只把一行写进自己的环形缓冲区（写满丢弃并计数，不阻塞请求），后台线程批量写文件；
+// 文件超过大小上限时改名切分（只有后台线程写文件，不影响工作线程），切分出的文件交给低优先级线程压缩
+class AccessLog {
+public:
+    static AccessLog* Instance();
+
+    // 打开访问日志，compress 为 gzip 或 none
+    bool Open(const std::string& path, size_t maxBytes, int flushIntervalMs,
+        const std::string& compress, size_t ringSize);
+
+    // 写完剩余内容、压缩完已切分的文件后关闭
+    void Close();
+
+    bool IsOpen() const { return _is_open.load(std::memory_order_relaxed); }
+
+    // 记录一次请求
+    void Append(const char* ip, std::string_view method, std::string_view path,
+        int status, size_t bytes, int64_t latencyMs);
+
+    // 累计丢弃行数
+    uint64_t Dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    AccessLog();
+    ~AccessLog();
+
+    LogRing* LocalRing();                       // 当前线程的环形缓冲区
+    void FlushLoop();                           // 批量写文件线程
+    size_t FlushRings();                        // 把所有缓冲区写入文件，返回字节数
+    void Rotate();                              // 改名切分当前文件并打开新文件
+    void CompressLoop();                        // 压缩线程
+    static bool GzipFile(const std::string& src);  // 压缩为 src.gz 并删除 src
+
+    std::string _path;
+    size_t _max_bytes;                          // 单个文件大小上限
+    int _flush_interval_ms;
+    bool _compress;
+    size_t _ring_size;
+
+    int _fd;
+    size_t _file_bytes;                         // 当前文件已写入字节数
+
+    std::atomic<bool> _is_open;
+    std::atomic<uint64_t> _dropped;
+
+    std::mutex _rings_mtx;
+    std::vector<std::shared_ptr<LogRing>> _rings;
+    std::vector<std::shared_ptr<LogRing>> _flush_rings;
+    std::vector<struct iovec> _flush_iov;
+    std::vector<size_t> _flush_bytes;
+
+    std::mutex _flush_mtx;
+    std::condition_variable _flush_cond;
+    std::atomic<bool> _wake_pending;            // 已经请求唤醒写文件线程
+    bool _stop;
+    std::unique_ptr<std::thread> _flush_thread;
+
+    std::mutex _compress_mtx;
+    std::condition_variable _compress_cond;
+    std::deque<std::string> _compress_queue;    // 等待压缩的文件
+    bool _compress_stop;
+    std::unique_ptr<std::thread> _compress_thread;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+
+// 准入控制
+// 过载时直接回复预先生成的 503（带 Retry-After），在非阻塞套接字上发送，不阻塞主循环；
+// 按客户端 IPv4 地址记录并发连接数和请求速率令牌桶：表是固定大小的数组，每 8 个条目一组（两个缓存行），
+// 地址哈希到组内开放寻址，按组加锁（锁按组号取模共用），组满时放行不记录；
+// 另有全局新建连接速率令牌桶，只在主循环线程使用
+class Admission {
+public:
+    static Admission* Instance();
+
+    // tableSize 为条目数（向上取 2 的幂），perIpConns、perIpRate、connRate 为 0 表示不限，
+    // burst 为 0 时取对应速率，retryAfter 为 503 中 Retry-After 的秒数
+    void Init(size_t tableSize, int perIpConns, int perIpRate, int perIpBurst,
+        int connRate, int connBurst, int retryAfter);
+
+    // 新连接：全局速率和单 IP 连接数都没有超限时返回 true（主循环线程调用）
+    // counted 返回是否计入了该 IP 的连接数（不限制、Unix 域连接、组满放行时不计入）
+    bool AcquireConn(uint32_t ip, bool* counted);
+
+    // 连接关闭时登记，只对 AcquireConn 计入过的连接调用
+    void ReleaseConn(uint32_t ip);
+
+    // 新请求：从该 IP 的请求令牌桶取一个令牌，取不到返回 false
+    bool AcquireRequest(uint32_t ip);
+
+    // 预先生成的 503 响应（Connection: close）
+    std::string_view Response503() const { return _response_503; }
+
+    // 在新连接上发送 503 后关闭，不等待
+    void Reject(int fd);
+
+    // 累计拒绝的连接数和请求数
+    uint64_t Rejected() const { return _rejected.load(std::memory_order_relaxed); }
+
+private:
+    Admission();
+
+    // 表条目，ip 为 0 表示空
+    struct Entry {
+        uint32_t ip;
+        uint32_t conns;         // 并发连接数
+        float tokens;           // 请求令牌桶剩余令牌
+        uint32_t last_ms;       // 上次补充令牌的时间（相对 Init 的毫秒数）
+    };
+
+    static const size_t GROUP_SIZE = 8;
+    static const size_t LOCK_COUNT = 256;
+
+    // 在 ip 所在组中查找条目，没有时占用空条目或可回收的条目，组满返回 nullptr；调用方持有组锁
+    Entry* FindLocked(size_t group, uint32_t ip, uint32_t now);
+
+    // 按经过的时间补充令牌
+    void Refill(Entry* entry, uint32_t now) const;
+
+    size_t Group(uint32_t ip) const;
+    std::mutex& GroupLock(size_t group) { return _locks[group % LOCK_COUNT]; }
+    uint32_t NowMs() const;
+
+    bool _enabled;                          // 是否启用单 IP 限制
+    int _per_ip_conns;
+    float _per_ip_rate;                     // 每毫秒补充的令牌数
+    float _per_ip_burst;
+    std::unique_ptr<Entry[]> _table;
+    size_t _group_mask;
+    std::unique_ptr<std::mutex[]> _locks;
+    int64_t _start_ms;
+
+    double _conn_rate;                      // 全局新建连接每毫秒补充的令牌数，0 不限
+    double _conn_burst;
+    double _conn_tokens;
+    int64_t _conn_last_ms;
+
+    std::string _response_503;
+    std::atomic<uint64_t> _rejected;
+};
+
+#endif
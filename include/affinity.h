@@ -0,0 +1,47 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+// 线程放置
+// 按线程角色（反应堆、工作线程、日志线程）配置绑定的 CPU 集合和调度策略，各线程启动时调用 Apply 生效；
+// 内存按内核默认策略在首次访问的 CPU 所在 NUMA 节点分配，不另设内存策略
+class ThreadAffinity {
+public:
+    enum Role {
+        REACTOR = 0,    // 主循环
+        WORKER,         // 线程池工作线程
+        LOG,            // 异步写日志线程
+        ROLE_COUNT,
+    };
+
+    static ThreadAffinity* Instance();
+
+    // 设置某类线程的 CPU 列表（例如 "0-3,8"，为空不绑定）、调度策略（other batch idle fifo rr）和优先级
+    void SetRole(Role role, const std::string& cpus, const std::string& policy = "other", int priority = 0);
+
+    // 对当前线程生效，index 为同类线程中的序号：工作线程按序号轮流绑定到 CPU 列表中的单个 CPU
+    bool Apply(Role role, size_t index = 0);
+
+    // 解析 CPU 列表
+    static std::vector<int> ParseCpuList(const std::string& cpus);
+
+private:
+    ThreadAffinity();
+
+    // 解析调度策略名，未知返回 -1
+    static int ParsePolicy(const std::string& policy);
+
+    struct Placement {
+        std::vector<int> cpus;
+        int policy;
+        int priority;
+    };
+
+    Placement _placement[ROLE_COUNT];
+    std::mutex _mtx;
+};
+
+#endif
@@ -3,58 +3,99 @@
 
 #pragma once
 
-#include <cstring>   // 包含C字符串操作函数的头文件，如bzero
+#include <cstring>   // 包含C字符串操作函数的头文件，如memcpy
 #include <iostream>  // 输入输出流库头文件
+#include <string>
+#include <string_view>
+#include <mutex>
+#include <memory>
+#include <vector>
 #include <unistd.h>  // 包含Unix标准库的头文件，如write
-#include <sys/uio.h> // 包含readv函数所需的头文件
-#include <vector>    // 向量库头文件，用于存储数据
-#include <atomic>    // 原子操作库头文件
+#include <sys/uio.h> // 包含readv/writev函数所需的头文件
 #include <assert.h>  // 断言库头文件
 
+#include "objectpool.h"
+
+// 缓冲区内存块：固定大小，从共享的块池分配，缓冲区把若干块串成链表
+struct BufferChunk {
+    static constexpr size_t SIZE = 4096 - sizeof(void*);   // 块内数据大小，整块正好一页
+
+    BufferChunk* next;
+    char data[SIZE];
+};
+
+// 缓冲区块池：内存块从对象池分配，空闲块先缓存在线程本地，用完的块不归还系统
+class BufferChunkPool {
+public:
+    static BufferChunkPool* Instance();
+
+    // 设置预分配块数、是否预先映射页面、线程缓存每批转移的块数，须在第一次分配前调用
+    void Init(size_t initChunks, bool populate, size_t batch);
+
+    BufferChunk* Alloc() {
+        return Pool()->New();
+    }
+
+    // 归还以 chunk 开头、next 串起来的整条链表
+    void Free(BufferChunk* chunk);
+
+    // 当前已切分出的块数
+    size_t Total() {
+        return Pool()->Capacity();
+    }
+
+private:
+    BufferChunkPool() = default;
+
+    ObjectPool<BufferChunk>* Pool();
+
+    std::once_flag _init_flag;
+    std::unique_ptr<ObjectPool<BufferChunk>> _pool;
+};
+
+// 链式缓冲区
+// 数据存放在块链表中，读写位置是普通整数（单个连接同一时刻只有一个线程访问）；
+// 增长时追加新块而不搬移已有数据，清空时只重置位置并归还多余的块；
+// 读写套接字时直接由块链表构造 iovec，用 readv/writev 完成
 class Buffer {
 public:
-    // 构造函数，初始化缓冲区大小，默认为1024字节
-    Buffer(int initBuffSize = 1024);
-    ~Buffer() = default;
+    static constexpr size_t npos = static_cast<size_t>(-1);
 
-    // 返回可写入的字节数
-    size_t WritableBytes() const;
+    Buffer();
+    ~Buffer();
 
-    // 返回可读取的字节数
-    size_t ReadableBytes() const;
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
 
-    // 返回已预留的字节数
-    size_t PrependableBytes() const;
+    // 返回可读取的字节数
+    size_t ReadableBytes() const { return _readable; }
 
-    // 返回缓冲区数据的起始指针
-    const char* Peek() const;
+    // 持有的内存块数
+    size_t ChunkCount() const { return _chunk_count; }
 
-    // 确保缓冲区可写入指定长度的数据
-    void EnsureWriteable(size_t len);
+    // 从可读数据开头查找 pattern，返回相对可读数据开头的偏移，找不到返回 npos
+    size_t Find(const char* pattern, size_t len, size_t maxLen = npos) const;
 
-    // 标记已写入指定长度的数据
-    void HasWritten(size_t len);
+    // 复制可读数据开头的 len 个字节（不移动读位置）
+    std::string PeekString(size_t len) const;
+    void PeekCopy(char* dst, size_t len) const;
 
-    // 从缓冲区中读取指定长度的数据，移动读指针
+    // 移动读位置，跳过 len 个字节
     void Retrieve(size_t len);
 
-    // 从缓冲区中读取数据直至指定位置，移动读指针
-    void RetrieveUntil(const char* end);
-
-    // 重置缓冲区，将所有数据清空
+    // 清空缓冲区，保留一个块复用
     void RetrieveAll();
 
+    // 丢弃数据并把全部块还给块池，下次写入时再取（空闲连接不占内存）
+    void Release();
+
     // 将缓冲区内的所有数据转为字符串并清空缓冲区
     std::string RetrieveAllToStr();
 
-    // 返回写指针的常量指针
-    const char* BeginWriteConst() const;
-
-    // 返回写指针的指针
-    char* BeginWrite();
-
     // 在缓冲区末尾追加字符串
     void Append(const std::string& str);
+    void Append(std::string_view str);
+    void Append(const char* str);
 
     // 在缓冲区末尾追加指定长度的字符串
     void Append(const char* str, size_t len);
@@ -68,28 +109,30 @@ public:
     // 从文件描述符中读取数据到缓冲区
     ssize_t ReadFd(int fd, int* Errno);
 
-    // 将缓冲区数据写入文件描述符
-    ssize_t WriteFd(int fd, int* Errno);
+    // 将缓冲区数据写入文件描述符，tail 不为空时在缓冲区数据之后一并写出（如 mmap 的文件），并随写入前移
+    ssize_t WriteFd(int fd, int* Errno, struct iovec* tail = nullptr);
 
 private:
-    // 返回缓冲区的起始指针
-    char* BeginPtr_();
-
-    // 返回缓冲区的起始指针（常量版本）
-    const char* BeginPtr_() const;
-
-    // 扩展缓冲区的大小以容纳指定长度的数据
-    void MakeSpace_(size_t len);
-
-    // 存储实际数据的向量
-    std::vector<char> _buffer;
-
-    // 读指针位置，原子类型，支持多线程并发操作
-    std::atomic<std::size_t> _read_pos;
-
-    // 写指针位置，原子类型，支持多线程并发操作
-    std::atomic<std::size_t> _write_pos;
+    static const int READ_CHUNKS = 4;       // 每次 readv 最多追加的新块数
+    static const int WRITE_IOV_MAX = 64;    // 每次 writev 最多使用的 iovec 数
+
+    // 尾块剩余可写字节数
+    size_t TailWritable() const {
+        return _tail ? BufferChunk::SIZE - _write_pos : 0;
+    }
+
+    // 追加一个新块作为尾块
+    void AppendChunk(BufferChunk* chunk);
+
+    // 释放已读完的头块
+    void ReleaseHead();
+
+    BufferChunk* _head;         // 第一个块，读位置所在
+    BufferChunk* _tail;         // 最后一个块，写位置所在
+    size_t _read_pos;           // 头块内的读位置
+    size_t _write_pos;          // 尾块内的写位置
+    size_t _readable;           // 可读字节总数
+    size_t _chunk_count;        // 块数
 };
 
 //#endif // _bufferH
-
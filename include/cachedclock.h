@@ -0,0 +1,35 @@
+#ifndef CACHED_CLOCK_H
+#define CACHED_CLOCK_H
+
+#include <atomic>
+#include <stdint.h>
+
+// 缓存时钟
+// 主循环每轮 epoll_wait 返回后调用一次 Update()，主循环线程（时间轮、准入、响应头）只读缓存值；
+// 主循环空闲时可能长时间阻塞在 epoll_wait，缓存值会过期，其他线程（工作线程、日志、注册写合并）
+// 直接读粗粒度时钟（CLOCK_*_COARSE 走 vDSO，不进内核）；
+// 格式化好的日志时间前缀和 HTTP Date 字符串按线程缓存，秒数变化时才重新格式化
+class CachedClock {
+public:
+    // 刷新缓存时间，由主循环线程调用，调用它的线程之后读缓存值
+    static void Update();
+
+    // 粗粒度单调时钟（毫秒）
+    static int64_t MonoMs();
+
+    // 墙上时间（微秒）
+    static int64_t WallUs();
+
+    // 日志时间前缀 "YYYY-MM-DD HH:MM:SS"（本地时间），mday 返回当月第几天
+    static const char* LogPrefix(int* mday = nullptr);
+
+    // RFC 7231 格式的 HTTP 日期 "Sun, 06 Nov 1994 08:49:37 GMT"
+    static const char* HttpDate();
+
+private:
+    static std::atomic<int64_t> _mono_ms;
+    static std::atomic<int64_t> _wall_us;
+    static thread_local bool t_owner;   // 当前线程是否为调用 Update() 的主循环线程
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef EMBEDDED_STORE_H
+#define EMBEDDED_STORE_H
+
+#include <string>
+#include <unordered_map>
+#include <shared_mutex>
+#include <stdint.h>
+
+#include "userstore.h"
+
+// 进程内用户存储
+// 数据保存在一个内存映射的只追加日志文件里，内存中按用户名和手机号建立哈希索引，
+// 登录、注册不需要访问网络，适合单机部署和压测
+class EmbeddedUserStore : public UserStore {
+public:
+    static EmbeddedUserStore* Instance();
+
+    // 打开（不存在则创建）日志文件，回放已有记录重建索引
+    bool Open(const std::string& path, size_t growSize = 4 * 1024 * 1024);
+
+    // 同步到磁盘并关闭文件
+    void Close();
+
+    int Register(const std::string& name, const std::string& phone, const std::string& passwd) override;
+    int Login(const std::string& name, const std::string& passwd) override;
+
+    // 记录条数
+    size_t Size();
+
+private:
+    EmbeddedUserStore();
+    ~EmbeddedUserStore();
+
+    // 文件头，used 为已写入的字节数（含文件头）
+    struct FileHeader {
+        char magic[8];
+        uint64_t used;
+    };
+
+    // 记录头，紧跟 name、phone、passwd 三段数据
+    struct RecordHeader {
+        uint32_t len;               // 整条记录长度（含记录头）
+        uint16_t name_len;
+        uint16_t phone_len;
+        uint16_t passwd_len;
+        uint16_t reserved;
+    };
+
+    bool Grow(size_t need);                          // 扩大文件并重新映射
+    bool Replay();                                   // 回放日志重建索引
+    void IndexRecord(uint64_t off);                  // 把一条记录加入索引
+    bool CheckPasswd(uint64_t off, const std::string& passwd) const;  // 比较记录中的密码
+
+    int _fd;                                         // 日志文件描述符
+    char* _base;                                     // 映射起始地址
+    size_t _capacity;                                // 映射（文件）大小
+    size_t _grow_size;                               // 每次扩容大小
+
+    std::unordered_map<std::string, uint64_t> _phone_index;       // 手机号 -> 记录偏移
+    std::unordered_multimap<std::string, uint64_t> _name_index;   // 用户名 -> 记录偏移（用户名可重复）
+    std::shared_mutex _mtx;                          // 登录共享，注册和扩容独占
+};
+
+#endif
@@ -9,22 +9,54 @@
 #include <arpa/inet.h>   
 #include <stdlib.h>     
 #include <errno.h>      
+#include <limits.h>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <unordered_map>
 
 #include "log.h"
 #include "sqlconnectionRAII.h"
 #include "buff.h"
+#include "requestarena.h"
 #include "httprequest.h"
 #include "httpresponse.h"
+#include "timingwheel.h"
+#include "accesslog.h"
+#include "admission.h"
+
+ class HttpConn;
+
+// 连接的热数据：主循环每个事件都要访问的字段，正好一个缓存行
+// 按 fd 下标存放在服务器的连续数组里，分发事件只访问这里，不碰连接对象本身
+struct alignas(64) HttpConnHot {
+    TimerNode timer;                // 超时定时器节点，data 指向本结构
+    struct iovec file_iov;          // 待写出的 mmap 文件部分，跟在写缓冲区之后写出
+    HttpConn* conn;                 // 冷数据：缓冲区、请求、响应等，按需从对象池分配
+    int fd;                         // 套接字文件描述符
+    std::atomic<bool> is_close;     // 连接是否关闭（工作线程关闭，主循环的定时器读）
+};
+static_assert(sizeof(HttpConnHot) == 64, "HttpConnHot 应正好占一个缓存行");
 
  // HTTP连接类，处理HTTP请求和响应
 class HttpConn {
 public:
+    // 连接所处阶段，每个阶段有各自的超时，从进入阶段起计时
+    enum CONN_PHASE {
+        IDLE,           // keep-alive 空闲，等待下一个请求
+        READ_HEADER,    // 读请求行和请求头，读到数据不延长期限
+        READ_BODY,      // 读请求体，读到数据不延长期限
+        WRITE,          // 写响应，每次写出进展都重新计时
+        ABORT,          // 请求头超限，等待重置
+        PHASE_COUNT,
+    };
+
     HttpConn();
 
     ~HttpConn();
 
-    // 初始化连接
-    void init(int sockFd, const sockaddr_in& addr);
+    // 初始化连接，hot 为该 fd 在热数据数组中的槽，connCounted 为准入控制是否计入了该连接（关闭时据此释放）
+    void init(HttpConnHot* hot, int sockFd, const sockaddr_in& addr, bool connCounted = false);
 
     // 从套接字读取数据
     ssize_t read(int* saveErrno);
@@ -32,32 +64,98 @@ public:
     // 向套接字写入数据
     ssize_t write(int* saveErrno);
 
-    // 关闭连接
+    // 关闭连接，主循环和工作线程同时关闭时只有一方生效；还有任务引用连接时描述符推迟到最后一个任务结束再关闭
     void Close();
 
+    // 连接代数，每次关闭加一；提交任务时记下，任务开始时代数变了说明连接已关闭，任务直接放弃
+    uint32_t Gen() const {
+        return _gen.load(std::memory_order_acquire);
+    }
+    bool IsStale(uint32_t gen) const {
+        return Gen() != gen;
+    }
+    bool IsClosed() const {
+        return _state.load(std::memory_order_acquire) & CLOSING;
+    }
+
+    // 排队或执行中的任务引用计数：有引用时描述符不关闭，不会被新连接复用，连接对象也不会被重新初始化
+    void Ref() {
+        _state.fetch_add(1, std::memory_order_relaxed);
+    }
+    void Unref();
+
     // 获取套接字文件描述符
     int GetFd() const;
 
-    // 获取端口号
+    // 获取端口号（主机字节序），Unix 域套接字上的连接为 0
     int GetPort() const;
 
-    // 获取IP地址
+    // 获取IP地址，Unix 域套接字上的连接为 "unix"
     const char* GetIP() const;
 
+    // 是否为 Unix 域套接字上的连接（地址族记为 AF_UNIX，IP 和端口为 0）
+    bool IsUnix() const { return _addr.sin_family == AF_UNIX; }
+
     // 获取套接字地址
     sockaddr_in GetAddr() const;
 
     // 处理HTTP请求
     bool process();
 
+    // 响应写完后记录访问日志
+    void LogAccess();
+
+    // 归还缓冲区、请求级内存并解除文件映射，连接空闲或关闭时调用
+    void ReleaseMemory();
+
+    // 当前连接占用的内存字节数（连接对象本身加上持有的内存块）
+    size_t MemoryBytes() const;
+
+    // 当前阶段及其开始时间（缓存单调时钟），超时检查时使用
+    // 工作线程写、主循环的定时器读：先读阶段再读开始时间，读到的开始时间不早于该阶段的开始时间
+    CONN_PHASE Phase() const {
+        return _phase.load(std::memory_order_acquire);
+    }
+    int64_t PhaseStartMs() const {
+        return _phase_start_ms.load(std::memory_order_relaxed);
+    }
+
+    // 请求头超过限制，连接应直接重置
+    bool IsAborted() const {
+        return Phase() == ABORT;
+    }
+
+    // 读缓冲区中是否还有未处理的数据（流水线上的后续请求）
+    bool HasReadData() const {
+        return read_buff.ReadableBytes() > 0;
+    }
+
+    // 读缓冲区中的请求是否为需要访问数据库的路由（只看请求行，不解析）
+    bool IsDbRequest() const;
+
+    // 读缓冲区中的请求是否为小静态文件的 GET：文件不超过 maxBytes 且全部在页缓存中，主循环处理时不会读盘
+    // 判定结果按文件路径缓存 STATIC_RECHECK_MS，只在主循环线程调用
+    bool IsCachedStatic(size_t maxBytes) const;
+
     // 获取待写入的字节数
     int ToWriteBytes() {
-        return _iov[0].iov_len + _iov[1].iov_len;
+        return write_buff.ReadableBytes() + _hot->file_iov.iov_len;
     }
 
-    // 检查是否保持连接
+    // 检查是否保持连接（请求要求保持且没有达到每连接请求数上限）
     bool IsKeepAlive() const {
-        return _request.IsKeepAlive();
+        return _response.IsKeepAlive();
+    }
+
+    // 取出最老的空闲连接，要求进入空闲的时间不晚于 idleBeforeMs，没有返回 nullptr
+    static HttpConn* PopIdle(int64_t idleBeforeMs);
+
+    // 空闲连接数
+    static size_t IdleCount();
+
+    // 热数据槽，超时定时器节点也在里面，由主循环线程的时间轮管理
+    HttpConnHot* GetHot() {
+        return _hot;
     }
 
     // 是否为边沿触发模式
@@ -69,21 +167,76 @@ public:
     // 当前连接用户数
     static std::atomic<int> _user_count;
 
+    // 每个连接最多处理的请求数，0 不限
+    static int _keep_alive_max;
+
 private:
+    // 把请求行开头复制到 head，取出方法和路径（路径不含查询串），请求行完整时返回 true
+    bool PeekRequestLine(char* head, size_t size, std::string_view* method, std::string_view* path) const;
 
-    int _fd;                        // 套接字文件描述符
-    struct sockaddr_in _addr;       // 套接字地址
+    // 文件的页是否全部在页缓存中（映射后用 mincore 查看，不访问映射的内存）
+    static bool IsResident(const char* file, size_t size);
+
+    // 进入阶段 phase，已在该阶段时不重新计时
+    void EnterPhase(CONN_PHASE phase);
+
+    // 当前阶段有进展，重新开始计时（写响应阶段使用，连接此时不在空闲链表中）
+    void TouchPhase() {
+        _phase_start_ms.store(CachedClock::MonoMs(), std::memory_order_relaxed);
+    }
 
-    bool _is_close;                 // 连接是否关闭
+    // 加入、移出空闲连接链表
+    void LinkIdle();
+    void UnlinkIdle();
+    void UnlinkIdleLocked();
 
-    int _iov_cnt;                   // iov 数量
-    struct iovec _iov[2];           // 用于readv/writev
+    // 连接关闭且没有任务引用后，解除文件映射并关闭描述符
+    void Finish();
+
+    static const uint32_t CLOSING = 1u << 31;    // _state 的关闭标志位，低位为任务引用数
+
+    HttpConnHot* _hot;              // 热数据槽（fd、关闭标志、定时器、文件写出位置）
+    struct sockaddr_in _addr;       // 套接字地址
 
     Buffer read_buff;               // 读缓冲区
-    Buffer write_buff;              // 写缓冲区
+    Buffer write_buff;              // 写缓冲区（响应头及非文件内容）
 
+    RequestArena _arena;            // 请求级内存，在 _request 之前构造、之后析构
     HttpRequest _request;           // HTTP请求
     HttpResponse _response;         // HTTP响应
+
+    int64_t _request_start_ms;      // 当前请求开始时间（缓存单调时钟），访问日志计算耗时
+    size_t _response_bytes;         // 当前响应总字节数
+
+    std::atomic<CONN_PHASE> _phase;         // 当前阶段
+    std::atomic<int64_t> _phase_start_ms;   // 进入当前阶段（写响应时为最后一次写出）的时间，先于阶段写入
+    int _request_count;             // 本连接已处理的请求数
+    bool _corked;                   // 大响应写出期间套接字已塞住（TCP_CORK）
+    bool _conn_counted;             // 准入控制计入了本连接，关闭时释放
+
+    std::atomic<uint32_t> _gen;     // 连接代数
+    std::atomic<uint32_t> _state;   // 关闭标志位 | 任务引用数
+
+    // keep-alive 空闲连接按进入空闲的先后串成链表（表头最老），连接数接近上限时从表头开始关闭
+    HttpConn* _idle_prev;
+    HttpConn* _idle_next;
+    bool _idle_linked;
+
+    static std::mutex _idle_mtx;
+    static HttpConn* _idle_head;
+    static HttpConn* _idle_tail;
+    static size_t _idle_count;
+
+    // 小静态文件的页缓存判定，按路径哈希索引，在有效期内不再 stat 和 mincore
+    struct StaticProbe {
+        std::string file;           // 完整路径，哈希冲突时比较
+        size_t size;                // 文件大小
+        int64_t checked_ms;         // 判定时间（缓存单调时钟）
+        bool resident;              // 文件页是否全部在页缓存中
+    };
+    static const int64_t STATIC_RECHECK_MS = 1000;  // 判定有效期，过期后重新 stat 和 mincore（文件可能被修改或换出）
+    static const size_t STATIC_PROBE_MAX = 4096;    // 最多缓存的路径数，满了整体清空
+    static std::unordered_map<size_t, StaticProbe> _static_probes;
 };
 
 
@@ -5,7 +5,8 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <memory_resource>
 #include <errno.h>     
 #include <mysql/mysql.h>
 #include <sys/stat.h>
@@ -39,29 +40,38 @@ public:
         FILE_REQUEST,
         INTERNAL_ERROR,
         CLOSED_CONNECTION,
+        TOO_LARGE_REQUEST,
     };
 
-    HttpRequest() { Init(); }
+    // 请求级的字符串和表都从 arena 分配，arena 由连接持有，两个请求之间整体回收
+    using PmrString = std::pmr::string;
+    using PmrMap = std::pmr::unordered_map<std::pmr::string, std::pmr::string>;
+
+    explicit HttpRequest(std::pmr::memory_resource* arena = std::pmr::get_default_resource());
     ~HttpRequest() = default;
 
-    // 初始化请求对象
+    // 初始化请求对象，放弃上一个请求在 arena 中的内存（之后 arena 才能回收）
     void Init();
 
-    // 解析HTTP请求
-    bool parse(Buffer& buff);
+    // 解析HTTP请求：请求头收齐后才开始解析，POST 请求体按 Content-Length 收齐
+    // 返回 GET_REQUEST 解析完成，NO_REQUEST 还需要更多数据，BAD_REQUEST 请求行错误，TOO_LARGE_REQUEST 请求头超限
+    HTTP_CODE parse(Buffer& buff);
+
+    // 当前解析状态，BODY 表示请求头已解析、正在等待请求体
+    PARSE_STATE State() const { return _state; }
 
     // 获取请求路径
-    std::string path() const;
-    std::string& path();
+    const PmrString& path() const;
+    PmrString& path();
 
     // 获取HTTP方法
-    std::string method() const;
+    const PmrString& method() const;
 
     // 获取HTTP版本
-    std::string version() const;
+    const PmrString& version() const;
 
     // 获取请求报头
-    const std::unordered_map<std::string, std::string>& Handler();
+    const PmrMap& Handler();
     size_t ContentLenth();
     size_t BodyLenth();
     
@@ -70,12 +80,15 @@ public:
     // 获取POST请求参数
     std::string GetPost(const std::string& key) const;
     std::string GetPost(const char* key) const;
-    const std::unordered_map<std::string, std::string>& GetPost();
+    const PmrMap& GetPost();
     
 
     // 检查是否保持连接
     bool IsKeepAlive() const;
 
+    // X-Forwarded-For 中最右边的地址（最近一跳代理看到的客户端），没有该头部时为空
+    std::string_view ForwardedFor() const;
+
     void ParseJson();
 
     void ParseFromData();
@@ -86,15 +99,15 @@ public:
 
 private:
     // 解析请求行
-    bool ParseRequestLine(const std::string& line);
+    bool ParseRequestLine(std::string_view line);
 
     // 解析请求头部
-    void ParseHeader(const std::string& line);
+    void ParseHeader(std::string_view line);
 
     // 解析路径
     void ParsePath();
     
-    void ParseBody(const std::string& line);
+    void ParseBody(std::string_view line);
     
     // 解析POST请求参数
     void ParsePost();
@@ -102,15 +115,23 @@ private:
     // 解析Url编码的POST参数
     void ParseFromUrlencoded();
 
+    std::pmr::memory_resource* _arena;                      // 请求级内存
     PARSE_STATE _state;                                     // 解析状态
-    std::string _method, _path, _version, _body;            // 请求方法、路径、版本和请求体
+    PmrString _method, _path, _version, _body;              // 请求方法、路径、版本和请求体
+    PmrString _line;                                        // 当前解析的一行
+    size_t _header_lines;                                   // 已解析的请求头行数（重名的行也计入）
     
     int _handle_body_state;                                 // 处理_body的结果
     
 
-    std::unordered_map<std::string, std::string> _header;   // 请求头部
-    std::unordered_map<std::string, std::string> _post;     // POST请求参数
+    PmrMap _header;                                         // 请求头部
+    PmrMap _post;                                           // POST请求参数
 
+public:
+    static size_t _max_header_bytes;                        // 请求行加请求头的最大字节数
+    static size_t _max_headers;                             // 请求头最大个数
+
+private:
     // 默认的标签映射
     static const std::unordered_set<std::string> _default_html;
     static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
@@ -13,6 +13,8 @@
 
 #include "buff.h"
 #include "log.h"
+#include "cachedclock.h"
+#include "httprequest.h"
 #include "mysqlopt.h"
 
  // HTTP响应类，用于生成HTTP响应
@@ -21,9 +23,8 @@ public:
     HttpResponse();
     ~HttpResponse();
 
-    // 初始化响应对象
-    // 在 httpresponse.h 中
-    void Init(const std::string& _src_dir, std::string& path, bool isKeepAlive = false, int code = -1, const std::unordered_map<std::string, std::string>& post = std::unordered_map<std::string, std::string>());
+    // 初始化响应对象，post 指向请求的参数表（不复制），在响应生成期间有效
+    void Init(const char* srcDir, std::string_view path, bool isKeepAlive = false, int code = -1, const HttpRequest::PmrMap* post = nullptr);
 
     // 构建HTTP响应报文
     void MakeResponse(Buffer& buff);
@@ -43,6 +44,18 @@ public:
     // 获取HTTP响应状态码
     int Code() const { return _code; }
 
+    // 是否保持连接
+    bool IsKeepAlive() const { return _isKeepAlive; }
+
+    // 本连接还能处理的请求数，在 keep-alive 响应头中通告，0 表示不限
+    void SetKeepAliveLeft(int left) { _keep_alive_left = left; }
+
+    // 空闲超时（秒），在 keep-alive 响应头中通告，0 不通告
+    static int _keep_alive_timeout;
+
+    // 路径是否为需要访问数据库的路由（登录、注册）
+    static bool IsRoute(std::string_view path);
+
 
 private:
     void HandlerRegister();
@@ -62,19 +75,22 @@ private:
     void ErrorHtml();
 
     // 获取文件类型
-    std::string GetFileType_();
+    const std::string& GetFileType_();
+
+    // 资源根目录 + 请求路径，复用成员字符串的内存
+    const char* FilePath();
     
     
-    std::unordered_map<std::string, std::string> _post;
-
-    //const std::unordered_map<std::string, std::string>& _post;
+    const HttpRequest::PmrMap* _post;   // 请求的 POST 参数
     
     int _code;              // 响应状态码
     std::string _status;    // 状态码说明
     bool _isKeepAlive;      // 是否保持连接
+    int _keep_alive_left;   // 本连接还能处理的请求数
 
     std::string _path;      // 请求路径
     std::string _src_root_dir;    // 资源根目录目录路径
+    std::string _file_path;       // 文件完整路径
 
     char* _mm_file;           // 内存映射文件指针
     struct stat _mm_file_stat; // 文件状态信息
@@ -4,76 +4,346 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <type_traits>
+#include <stdint.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <string.h>
-#include <stdarg.h>         
+#include <stdarg.h>
 #include <assert.h>
-#include <sys/stat.h>       
-#include "blockqueue.h"       
-#include "buff.h"
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "cachedclock.h"
+
+// 单生产者单消费者的日志环形缓冲区
+// 每个写日志的线程一个，写线程只移动写位置，后台刷盘线程只移动读位置，不加锁
+class LogRing {
+public:
+    explicit LogRing(size_t capacity);
+    ~LogRing();
+
+    // 写入一行，空间不足返回 false
+    bool TryPush(const char* data, size_t len);
+
+    // 取出可读区域（绕回时分成两段），返回可读字节数
+    size_t Peek(struct iovec iov[2]) const;
+
+    // 丢弃已写入文件的 n 个字节
+    void Consume(size_t n);
+
+    // 已使用字节数
+    size_t Used() const;
+
+    size_t Capacity() const { return _capacity; }
+
+    // 所属线程已退出，读空后可以回收
+    void Detach() { _detached.store(true, std::memory_order_release); }
+    bool IsDetached() const { return _detached.load(std::memory_order_acquire); }
+
+private:
+    char* _buf;
+    size_t _capacity;                               // 2 的幂
+    size_t _mask;
+    std::atomic<bool> _detached;
+    alignas(64) std::atomic<size_t> _write_pos;     // 写线程独占
+    alignas(64) std::atomic<size_t> _read_pos;      // 刷盘线程独占
+};
+
+// 调用点级别的日志限流，每个使用 LOG_*_RATE 的调用点一个静态实例
+// 按秒计数，超出的行丢弃并计数，下一秒第一次调用时报告上一秒丢弃的行数
+class LogRateLimiter {
+public:
+    // 是否允许写这一行；进入新的一秒时 suppressed 返回上一秒丢弃的行数
+    bool Allow(int rate, uint64_t* suppressed) {
+        *suppressed = 0;
+        if (rate <= 0) return true;
+        int64_t sec = CachedClock::MonoMs() / 1000;
+        int64_t window = _window.load(std::memory_order_relaxed);
+        if (window != sec && _window.compare_exchange_strong(window, sec, std::memory_order_relaxed)) {
+            _count.store(0, std::memory_order_relaxed);
+            *suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+        }
+        if (_count.fetch_add(1, std::memory_order_relaxed) < static_cast<uint32_t>(rate)) return true;
+        _suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+private:
+    std::atomic<int64_t> _window{ 0 };
+    std::atomic<uint32_t> _count{ 0 };
+    std::atomic<uint64_t> _suppressed{ 0 };
+};
 
 class Log {
 public:
+    static const int LOG_LINE_MAX = 1024;          // 单行最大长度，超出截断
+    // 缓冲区写满时的处理策略
+    enum OverflowPolicy {
+        OVERFLOW_BLOCK = 0,                         // 睡眠等待刷盘线程腾出空间（刷盘线程不能是 SCHED_IDLE）
+        OVERFLOW_DROP,                              // 丢弃并计数
+    };
+
     void init(int level, const char* path = "./log",
         const char* suffix = ".log",
         int maxQueueCapacity = 1024,
-        int log_max_size = 78402); // 初始化日志
+        int log_max_size = 78402,
+        int ringSizeKb = 256,
+        OverflowPolicy overflow = OVERFLOW_DROP,
+        int flushIntervalMs = 50,
+        bool binary = false); // 初始化日志
 
     static Log* Instance();                         // 获取单例实例
     static void FlushLogThread();                   // 异步写日志线程
 
     void write(int level, const char* format, ...); // 写日志
-    void flush();                                   // 刷新日志缓冲
+
+    // 二进制模式写日志：只记录格式串地址和原始参数，由刷盘线程格式化
+    template<class... Args>
+    void WriteBinary(int level, const char* format, const Args&... args);
+    void flush();                                   // 唤醒刷盘线程
 
     int GetLevel();                                 // 获取日志级别
     void SetLevel(int level);                       // 设置日志级别
-    bool IsOpen() { return _is_open; }               // 判断日志是否开启
+    bool IsOpen() { return _is_open.load(std::memory_order_relaxed); }  // 判断日志是否开启
+    bool IsBinary() { return _is_binary; }           // 是否为二进制（延迟格式化）模式
+
+    int GetSiteRate() { return _site_rate.load(std::memory_order_relaxed); }  // 限流调用点每秒最多行数，0 不限
+    void SetSiteRate(int rate) { _site_rate.store(rate, std::memory_order_relaxed); }
+
+    uint64_t DroppedLines() const { return _dropped_total.load(std::memory_order_relaxed); }  // 累计丢弃行数
+    uint64_t BadRecords() const { return _bad_total.load(std::memory_order_relaxed); }        // 累计跳过的损坏二进制记录数
 
 private:
     Log();
-    void AppendLogLevelTitle(int level);           // 添加日志级别标签
+    size_t AppendLogLevelTitle(int level, char* buf); // 添加日志级别标签
     virtual ~Log();
     void AsyncWrite();                             // 异步写日志
+    LogRing* LocalRing();                          // 当前线程的环形缓冲区，第一次使用时创建并登记
+    void Push(int level, const char* line, size_t len);  // 写入当前线程的环形缓冲区
+    size_t FlushRings();                           // 把所有环形缓冲区的内容批量写入文件，返回写入字节数
+    void WriteFile(const struct iovec* iov, int cnt, size_t lines);  // 写文件并按天、按行数切分
+    void RotateIfNeeded();                         // 需要时切换日志文件（持有 _mtx）
+    void WakeFlusher();                            // 唤醒刷盘线程
+    size_t DecodeBinary(const struct iovec iov[2], size_t bytes);  // 把二进制记录格式化到 _format_buf，返回行数
+    bool FormatRecord(const char* rec, size_t len); // 格式化一条二进制记录，参数区损坏时返回 false
+    static char* BinaryScratch();                   // 当前线程组装二进制记录的临时缓冲
+
+    // 二进制记录头，后面紧跟参数（1 字节类型 + 值）
+    struct BinaryHeader {
+        uint32_t len;                               // 整条记录长度（含记录头）
+        int32_t level;
+        int64_t us;                                 // 墙上时间（微秒）
+        const char* format;                         // 格式串地址，字符串字面量在进程内地址不变，当作格式串 ID
+    };
+
+    // 参数类型
+    enum ArgType : uint8_t {
+        ARG_INT = 1,
+        ARG_UINT,
+        ARG_DOUBLE,
+        ARG_STR,                                    // 2 字节长度 + 字符串内容（拷贝，不含结尾 0）
+        ARG_PTR,
+    };
+
+    static size_t PutRaw(char* rec, size_t n, ArgType type, const void* data, size_t len) {
+        if (n + 1 + len > LOG_LINE_MAX) return n;   // 超长截断
+        rec[n] = static_cast<char>(type);
+        memcpy(rec + n + 1, data, len);
+        return n + 1 + len;
+    }
+
+    template<class T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, size_t>::type
+    PutArg(char* rec, size_t n, const T& v) {
+        if (std::is_signed<T>::value) {
+            int64_t x = static_cast<int64_t>(v);
+            return PutRaw(rec, n, ARG_INT, &x, sizeof(x));
+        }
+        uint64_t x = static_cast<uint64_t>(v);
+        return PutRaw(rec, n, ARG_UINT, &x, sizeof(x));
+    }
+
+    static size_t PutArg(char* rec, size_t n, double v) {
+        return PutRaw(rec, n, ARG_DOUBLE, &v, sizeof(v));
+    }
+
+    static size_t PutArg(char* rec, size_t n, const char* s) {
+        if (s == nullptr) s = "(null)";
+        return PutString(rec, n, s, strlen(s));
+    }
+
+    static size_t PutArg(char* rec, size_t n, const std::string& s) {
+        return PutString(rec, n, s.data(), s.size());
+    }
+
+    template<class T>
+    static size_t PutArg(char* rec, size_t n, const T* p) {
+        uint64_t x = reinterpret_cast<uintptr_t>(p);
+        return PutRaw(rec, n, ARG_PTR, &x, sizeof(x));
+    }
+
+    static size_t PutString(char* rec, size_t n, const char* s, size_t len) {
+        if (n + 3 > LOG_LINE_MAX) return n;
+        len = std::min(len, static_cast<size_t>(LOG_LINE_MAX - n - 3));
+        uint16_t l = static_cast<uint16_t>(len);
+        rec[n] = static_cast<char>(ARG_STR);
+        memcpy(rec + n + 1, &l, sizeof(l));
+        memcpy(rec + n + 3, s, len);
+        return n + 3 + len;
+    }
 
 private:
     static const int LOG_PATH_LEN = 256;
     static const int LOG_NAME_LEN = 256;
     //static const int MAX_LINES = 5000;
 
-    const char* _path;                              // 日志存储路径
-    const char* _suffix;                            // 日志文件后缀
+    std::string _path;                              // 日志存储路径（保存副本，调用方的字符串可能已释放）
+    std::string _suffix;                            // 日志文件后缀
 
     int _log_max_lines;
 
     int _line_count;                                // 当前日志文件日志行数
-    int _to_day;                                    // 现在是哪一天                                    
+    int _to_day;                                    // 现在是哪一天
+    int _file_index;                                // 当天第几个切分文件
 
-    bool _is_open;                                  // 日志系统是否打开
+    std::atomic<bool> _is_open;                     // 日志系统是否打开
 
-    Buffer _buff;                                   // 日志缓冲
-    int _level;                                     // 日志级别
+    std::atomic<int> _level;                        // 日志级别
+    std::atomic<int> _site_rate;                    // 限流调用点每秒最多行数
     bool _is_async;                                 // 是否异步写日志
+    bool _is_binary;                                // 二进制模式，只在异步模式下生效
+
+    int _log_fd;                                    // 日志文件描述符
+    std::mutex _mtx;                                // 保护日志文件和切分状态
+
+    size_t _ring_size;                              // 每个线程环形缓冲区大小
+    OverflowPolicy _overflow;                       // 写满时的策略
+    int _flush_interval_ms;                         // 刷盘线程最长等待时间
+    std::atomic<uint64_t> _dropped;                 // 尚未报告的丢弃行数
+    std::atomic<uint64_t> _dropped_total;           // 累计丢弃行数
+
+    std::mutex _rings_mtx;                          // 保护 _rings，只在线程登记和刷盘线程取快照时使用
+    std::vector<std::shared_ptr<LogRing>> _rings;   // 所有线程的环形缓冲区
+    std::vector<std::shared_ptr<LogRing>> _flush_rings;  // 刷盘线程使用的快照，复用内存
+    std::vector<struct iovec> _flush_iov;           // 刷盘线程使用的 iovec，复用内存
+    std::vector<size_t> _flush_bytes;               // 本批从每个缓冲区取出的字节数
+    std::vector<char> _format_buf;                  // 二进制模式下格式化后的文本，复用内存
+    int64_t _format_sec;                            // _format_prefix 对应的秒数
+    char _format_prefix[72];                        // 刷盘线程缓存的时间前缀
+    uint64_t _bad_records;                          // 尚未报告的损坏二进制记录数（只有刷盘线程访问）
+    std::atomic<uint64_t> _bad_total;               // 累计损坏二进制记录数
+
+    std::mutex _flush_mtx;
+    std::condition_variable _flush_cond;
+    std::atomic<bool> _wake_pending;                // 已经请求唤醒刷盘线程
 
-    FILE* _log_file_fp;                                      // 日志文件指针
-    std::unique_ptr<BlockDeque<std::string>> _deque;// 阻塞队列，用于异步写日志
+    std::mutex _space_mtx;                          // block 策略下等待缓冲区空间
+    std::condition_variable _space_cond;            // 刷盘线程取走数据后通知
+    std::atomic<int> _space_waiters;                // 正在等待空间的线程数
+    bool _stop;
     std::unique_ptr<std::thread> _write_thread;      // 异步写日志的线程
-    std::mutex _mtx;                                // 互斥锁
 };
 
+template<class... Args>
+void Log::WriteBinary(int level, const char* format, const Args&... args) {
+    char* rec = BinaryScratch();
+    size_t n = sizeof(BinaryHeader);
+    int expand[] = { 0, (n = PutArg(rec, n, args), 0)... };
+    (void)expand;
+    BinaryHeader header;
+    header.len = static_cast<uint32_t>(n);
+    header.level = level;
+    header.us = CachedClock::WallUs();
+    header.format = format;
+    memcpy(rec, &header, sizeof(header));
+    Push(level, rec, n);
+}
+
+// 编译期最低日志等级（0 DEBUG 1 INFO 2 WARN 3 ERROR），低于该等级的调用点在编译期去掉，参数也不会求值
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+#define LOG_WRITE(log, level, format, ...) \
+    do {\
+        if (log->IsBinary()) log->WriteBinary(level, format, ##__VA_ARGS__); \
+        else log->write(level, format, ##__VA_ARGS__); \
+    } while(0)
+
 #define LOG_BASE(level, format, ...) \
     do {\
         Log* log = Log::Instance();\
         if (log->IsOpen() && log->GetLevel() <= level) {\
-            log->write(level, format, ##__VA_ARGS__); \
-            log->flush();\
+            LOG_WRITE(log, level, format, ##__VA_ARGS__); \
         }\
     } while(0);
 
+// 每秒最多 rate 行（rate <= 0 不限），超出部分丢弃，下一秒报告丢弃行数
+#define LOG_RATE_BASE(level, rate, format, ...) \
+    do {\
+        Log* log = Log::Instance();\
+        if (log->IsOpen() && log->GetLevel() <= level) {\
+            static LogRateLimiter _log_limiter;\
+            uint64_t _log_suppressed;\
+            bool _log_allow = _log_limiter.Allow(rate, &_log_suppressed);\
+            if (_log_suppressed > 0) {\
+                LOG_WRITE(log, 2, "日志限流：%s:%d 上一秒丢弃 %llu 行", __FILE__, __LINE__, (unsigned long long)_log_suppressed); \
+            }\
+            if (_log_allow) LOG_WRITE(log, level, format, ##__VA_ARGS__); \
+        }\
+    } while(0);
 
+// 每 n 次调用写一行
+#define LOG_SAMPLE_BASE(level, n, format, ...) \
+    do {\
+        Log* log = Log::Instance();\
+        if (log->IsOpen() && log->GetLevel() <= level) {\
+            static std::atomic<uint64_t> _log_sample_count{ 0 };\
+            if (_log_sample_count.fetch_add(1, std::memory_order_relaxed) % (n) == 0) {\
+                LOG_WRITE(log, level, format, ##__VA_ARGS__); \
+            }\
+        }\
+    } while(0);
+
+#define LOG_NONE(...) do {} while(0);
+
+#if LOG_MIN_LEVEL <= 0
 #define LOG_DEBUG(format, ...) do {LOG_BASE(0, format, ##__VA_ARGS__)} while(0);
+#define LOG_DEBUG_RATE(rate, format, ...) do {LOG_RATE_BASE(0, rate, format, ##__VA_ARGS__)} while(0);
+#define LOG_DEBUG_SAMPLE(n, format, ...) do {LOG_SAMPLE_BASE(0, n, format, ##__VA_ARGS__)} while(0);
+#else
+#define LOG_DEBUG(...) LOG_NONE()
+#define LOG_DEBUG_RATE(...) LOG_NONE()
+#define LOG_DEBUG_SAMPLE(...) LOG_NONE()
+#endif
+
+#if LOG_MIN_LEVEL <= 1
 #define LOG_INFO(format, ...) do {LOG_BASE(1, format, ##__VA_ARGS__)} while(0);
+#define LOG_INFO_RATE(rate, format, ...) do {LOG_RATE_BASE(1, rate, format, ##__VA_ARGS__)} while(0);
+#define LOG_INFO_SAMPLE(n, format, ...) do {LOG_SAMPLE_BASE(1, n, format, ##__VA_ARGS__)} while(0);
+#else
+#define LOG_INFO(...) LOG_NONE()
+#define LOG_INFO_RATE(...) LOG_NONE()
+#define LOG_INFO_SAMPLE(...) LOG_NONE()
+#endif
+
+#if LOG_MIN_LEVEL <= 2
 #define LOG_WARN(format, ...) do {LOG_BASE(2, format, ##__VA_ARGS__)} while(0);
-#define LOG_ERROR(format, ...) do {LOG_BASE(3, format, ##__VA_ARGS__)} while(0);
+#define LOG_WARN_RATE(rate, format, ...) do {LOG_RATE_BASE(2, rate, format, ##__VA_ARGS__)} while(0);
+#define LOG_WARN_SAMPLE(n, format, ...) do {LOG_SAMPLE_BASE(2, n, format, ##__VA_ARGS__)} while(0);
+#else
+#define LOG_WARN(...) LOG_NONE()
+#define LOG_WARN_RATE(...) LOG_NONE()
+#define LOG_WARN_SAMPLE(...) LOG_NONE()
+#endif
 
-#endif 
+#define LOG_ERROR(format, ...) do {LOG_BASE(3, format, ##__VA_ARGS__)} while(0);
+#define LOG_ERROR_RATE(rate, format, ...) do {LOG_RATE_BASE(3, rate, format, ##__VA_ARGS__)} while(0);
+#define LOG_ERROR_SAMPLE(n, format, ...) do {LOG_SAMPLE_BASE(3, n, format, ##__VA_ARGS__)} while(0);
 
+#endif
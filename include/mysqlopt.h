@@ -1,8 +1,16 @@
+#pragma once
+
 #include "sqlconnectionpool.h"
 #include "sqlconnectionRAII.h"
+#include "userstore.h"
 
 class MysqlOpt {
 public:
+  // 设置用户存储后端，默认为 MySQL
+  static void SetStore(UserStore* store);
   static int Register(const std::string& name, const std::string& phone, const std::string& passwd);
   static int Login(const std::string&name, const std::string& passwd);
+
+private:
+  static UserStore* _store;
 };
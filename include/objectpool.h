@@ -3,18 +3,27 @@
 
 #include <vector>
 #include <mutex>
+#include <memory>
+#include <new>
+#include <utility>
+#include <sys/mman.h>
 
 
+// 对象内存池
+// 前端是每个线程自己的空闲对象缓存，New/Delete 只操作本线程的自由链表，不加锁；
+// 线程缓存取空时从中心自由链表按批取，攒到两批时按批还回中心，中心自由链表加锁（类似 tcmalloc 的线程缓存）。
+// 同一类型的对象在一个线程里只缓存一个池的，交替使用同类型的多个池时线程缓存会来回换。
 template <class T>
 class ObjectPool
 {
     // 获取自由链表下一个对象的指针
-    void*& NextObj(void* ptr)
+    static void*& NextObj(void* ptr)
     {
         // 截取头32为：4,64位：8 的内容
         return (*(void**)ptr);
     }
-void* SystemAlloc(size_t size) {
+
+static void* SystemAlloc(size_t size, bool populate) {
     void* _memory = nullptr;
 #ifdef _WIN32
     _memory = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
@@ -23,17 +32,9 @@ void* SystemAlloc(size_t size) {
         throw std::bad_alloc();
     }
 #else
-    //if (_block_size <= 128 * 1024)
-    //{
-    //    _memory = sbrk(size);
-    //    if (_memory == (char*)-1)
-    //    {
-    //        throw std::bad_alloc();
-    //    }
-    //}
-    //else
-    //{
-    _memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    // populate 时申请即建立页表映射，运行中第一次访问不再缺页
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | (populate ? MAP_POPULATE : 0);
+    _memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
     if (_memory == MAP_FAILED)
     {
         throw std::bad_alloc();
@@ -42,7 +43,7 @@ void* SystemAlloc(size_t size) {
     return _memory;
 }
 
-void SystemFree(void* memory, size_t size)
+static void SystemFree(void* memory, size_t size)
 {
 #ifdef _WIN32
     VirtualFree(memory, 0, MEM_RELEASE);
@@ -51,107 +52,196 @@ void SystemFree(void* memory, size_t size)
 #endif
 }
 
-public:
-    // 构造函数，接受预分配对象个数和每次扩容的增量
-    ObjectPool(size_t init_capacity = 1024, size_t increment = 128, bool is_lock = false)
-        : _init_capacity(init_capacity),
-        _memory(nullptr),
-        _remain_size(0),
-        _free_list(nullptr),
-        _is_lock(is_lock)
+    // 中心自由链表和内存块，线程缓存也持有它的引用，池先析构时线程缓存仍能安全归还
+    struct Central
+    {
+        std::mutex _mtx;
+        void* _free_list = nullptr;         // 中心自由链表
+        char* _memory = nullptr;            // 当前内存块中未切分部分的起始位置
+        size_t _remain_size = 0;            // 当前内存块中剩余大小
+        size_t _block_size = 0;             // 下次扩容的内存块大小
+        size_t _obj_size = 0;               // 对象大小，最小保证能够存下地址
+        size_t _capacity = 0;               // 已切分出的对象个数
+        bool _populate = false;
+        std::vector<std::pair<char*, size_t>> _block_memory;   // 保存每次分配的新内存块
+
+        ~Central()
+        {
+            for (size_t i = 0; i < _block_memory.size(); i++) {
+                SystemFree(_block_memory[i].first, _block_memory[i].second);
+            }
+        }
+
+        void AddBlock(size_t size)
+        {
+            _memory = static_cast<char*>(SystemAlloc(size, _populate));
+            _remain_size = size;
+            _block_memory.push_back({ _memory, size });
+        }
+
+        // 取 n 个对象串成链表
+        void* FetchBatch(size_t n)
+        {
+            std::lock_guard<std::mutex> locker(_mtx);
+            void* list = nullptr;
+            for (size_t i = 0; i < n; i++) {
+                void* obj;
+                if (_free_list != nullptr)
+                {
+                    // 从自由链表头获取一个对象
+                    obj = _free_list;
+                    _free_list = NextObj(_free_list);
+                }
+                else
+                {
+                    if (_remain_size < _obj_size)
+                    {
+                        // 分配新的内存块，每次扩容大小翻倍
+                        _block_size *= 2;
+                        AddBlock(_block_size);
+                    }
+                    obj = _memory;
+                    _memory += _obj_size;
+                    _remain_size -= _obj_size;
+                    _capacity++;
+                }
+                NextObj(obj) = list;
+                list = obj;
+            }
+            return list;
+        }
+
+        // 归还 head 到 tail 串起来的一批对象
+        void ReleaseBatch(void* head, void* tail)
+        {
+            std::lock_guard<std::mutex> locker(_mtx);
+            NextObj(tail) = _free_list;
+            _free_list = head;
+        }
+    };
+
+    // 线程缓存
+    struct ThreadCache
     {
-        // 计算对象大小，确保能够存储地址
-        _obj_size = sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T);
-        _block_size = increment * _obj_size;
+        std::shared_ptr<Central> _central;
+        void* _free_list = nullptr;
+        size_t _count = 0;
+
+        ~ThreadCache()
+        {
+            Flush();
+        }
+
+        // 全部还给中心
+        void Flush()
+        {
+            if (_free_list == nullptr) return;
+            void* tail = _free_list;
+            while (NextObj(tail) != nullptr) tail = NextObj(tail);
+            _central->ReleaseBatch(_free_list, tail);
+            _free_list = nullptr;
+            _count = 0;
+        }
+    };
 
-        _memory = static_cast<char*>(SystemAlloc(_init_capacity * _obj_size));
-        if (_memory == nullptr)
+    ThreadCache& LocalCache()
+    {
+        static thread_local ThreadCache cache;
+        if (cache._central != _central)
         {
-            throw std::bad_alloc();
+            // 本线程之前缓存的是同类型另一个池的对象，先还回去
+            cache.Flush();
+            cache._central = _central;
         }
-        _remain_size = _init_capacity * _obj_size;
-        _block_memory.push_back({ _memory, _remain_size });
+        return cache;
     }
 
-    // 析构函数，释放所有已分配的内存块
-    ~ObjectPool()
+public:
+    // 构造函数，接受预分配对象个数、每次扩容的增量、是否预先映射页面、线程缓存每批转移的对象个数
+    ObjectPool(size_t init_capacity = 1024, size_t increment = 128, bool populate = false, size_t batch = 32)
+        : _central(std::make_shared<Central>()),
+        _batch(batch > 0 ? batch : 1)
     {
-        //std::unique_lock<std::mutex> lock(_mtx);
-        if (_is_lock) _mtx.lock();
-        for (int i = 0; i < _block_memory.size(); i++) {
-            SystemFree(_block_memory[i].first, _block_memory[i].second);
+        // 计算对象大小，确保能够存储地址，并按对象的对齐要求取整
+        size_t obj_size = sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T);
+        obj_size = (obj_size + alignof(T) - 1) / alignof(T) * alignof(T);
+        _central->_obj_size = obj_size;
+        _central->_block_size = (increment > 0 ? increment : 1) * obj_size;
+        _central->_populate = populate;
+        if (init_capacity > 0)
+        {
+            _central->AddBlock(init_capacity * obj_size);
         }
-        if (_is_lock) _mtx.unlock();
     }
 
-    // 申请对象，支持构造函数参数
+    // 析构函数，内存块在最后一个线程缓存释放后归还系统
+    ~ObjectPool() = default;
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // 申请对象，支持构造函数参数；没有参数时默认初始化（POD 类型不清零）
     template <typename... Args>
     T* New(Args&&... args)
     {
-        //std::unique_lock<std::mutex> lock(_mtx);
-        if (_is_lock) _mtx.lock();
-        T* obj = nullptr;
+        ThreadCache& cache = LocalCache();
+        if (cache._free_list == nullptr)
+        {
+            cache._free_list = _central->FetchBatch(_batch);
+            cache._count = _batch;
+        }
+        void* obj = cache._free_list;
+        cache._free_list = NextObj(obj);
+        cache._count--;
 
-        if (_free_list != nullptr)
+        // 使用 placement new 在已分配内存上调用构造函数，传递参数
+        if constexpr (sizeof...(Args) == 0)
         {
-            
-            // 从自由链表头获取一个对象
-            obj = static_cast<T*>(_free_list);
-            _free_list = NextObj(_free_list);
+            return new (obj) T;
         }
         else
         {
-            if (_remain_size < _obj_size)
-            {
-                // 分配新的内存块，大小为增量乘以对象大小
-                _block_size *= 2;
-                char* new_block = static_cast<char*>(SystemAlloc(_block_size));
-                if (new_block == nullptr)
-                {
-                    throw std::bad_alloc();
-                }
-
-                _memory = new_block;
-                _remain_size = _block_size;
-                _block_memory.push_back({ _memory, _block_size });
-
-            }
-            obj = reinterpret_cast<T*>(_memory);
-            if (obj == nullptr)
-            {
-                throw std::bad_alloc();
-            }
-            _memory += _obj_size;
-            _remain_size -= _obj_size;
+            return new (obj) T(std::forward<Args>(args)...);
         }
-        // 使用 placement new 在已分配内存上调用构造函数，传递参数
-        new (obj) T(std::forward<Args>(args)...);
-
-        if (_is_lock) _mtx.unlock();
-        return obj;
     }
 
     void Delete(T* obj)
     {
-        //std::unique_lock<std::mutex> lock(_mtx);
-        if (_is_lock) _mtx.lock();
+        if (obj == nullptr) return;
         obj->~T();
-        // 将对象插入自由链表
-        NextObj(obj) = _free_list;
-        _free_list = obj;
-        if (_is_lock) _mtx.unlock();
+        // 将对象插入本线程的自由链表
+        ThreadCache& cache = LocalCache();
+        NextObj(obj) = cache._free_list;
+        cache._free_list = obj;
+        cache._count++;
+        if (cache._count >= 2 * _batch)
+        {
+            // 攒多了，还一批给中心，其他线程可以再取
+            void* head = cache._free_list;
+            void* tail = head;
+            for (size_t i = 1; i < _batch; i++) tail = NextObj(tail);
+            cache._free_list = NextObj(tail);
+            cache._count -= _batch;
+            _central->ReleaseBatch(head, tail);
+        }
+    }
+
+    // 已切分出的对象个数（使用中、线程缓存和中心自由链表里的总和）
+    size_t Capacity()
+    {
+        std::lock_guard<std::mutex> locker(_central->_mtx);
+        return _central->_capacity;
+    }
+
+    // 单个对象占用的字节数
+    size_t ObjectSize() const
+    {
+        return _central->_obj_size;
     }
 
 private:
-    size_t _init_capacity;
-    size_t _block_size;                 // 分配新的内存块，大小为增量乘以对象大小
-    size_t _obj_size;                   // 对象大小，最小保证能够存下地址
-    char* _memory;                      // 指向分配的内存块
-    size_t _remain_size;                // 当前内存块中剩余大小
-    void* _free_list;                   // 指向自由链表的头指针
-    std::vector<std::pair<char*, size_t>> _block_memory;   // 保存每次分配的新内存块
-    std::mutex _mtx;
-    bool _is_lock;
+    std::shared_ptr<Central> _central;
+    size_t _batch;                      // 线程缓存和中心之间每批转移的对象个数
 };
 
 #endif
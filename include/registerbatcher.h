@@ -0,0 +1,67 @@
+#ifndef REGISTER_BATCHER_H
+#define REGISTER_BATCHER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <atomic>
+
+#include "sqlconnectionpool.h"
+#include "sqlconnectionRAII.h"
+
+// 注册写合并器
+// 并发的注册请求先进入等待队列，后台线程最多等待 max_wait_ms 毫秒或凑够 max_rows 行，
+// 然后用一条多行 INSERT 在一个事务中提交，每个请求按自己那一行的结果返回
+class RegisterBatcher {
+public:
+    static RegisterBatcher* Instance();
+
+    // 启动后台提交线程
+    void Init(int maxRows = 64, int maxWaitMs = 5);
+
+    // 关闭合并器，等待队列中的请求全部提交完
+    void Close();
+
+    // 合并器是否开启
+    bool IsOpen() const { return _is_open; }
+
+    // 提交一条注册请求，阻塞直到所在批次提交完成
+    // 返回值与 MysqlOpt::Register 一致：0 成功，-1 失败，-2 手机号已存在
+    int Submit(const std::string& name, const std::string& phone, const std::string& passwd);
+
+private:
+    RegisterBatcher();
+    ~RegisterBatcher();
+
+    // 等待中的注册请求
+    struct Pending {
+        std::string name;
+        std::string phone;
+        std::string passwd;
+        std::promise<int> result;
+    };
+    typedef std::vector<std::unique_ptr<Pending>> Batch;
+
+    void Run();                                     // 后台提交线程
+    void CommitBatch(Batch& batch);                 // 一个事务提交整批
+    void CommitOneByOne(SqlConnRAII& conn, Batch& batch, std::vector<int>& res);  // 整批失败时逐行提交
+
+    // 取数据库连接的最长等待时间：一批最多 max_rows 个请求，池暂时用完时等其他线程归还，不让整批直接失败
+    static const int CONN_WAIT_MS = 1000;
+
+    int _max_rows;                                  // 每批最大行数
+    int _max_wait_ms;                               // 每批最长等待时间
+    std::atomic<bool> _is_open;
+
+    Batch _queue;                                   // 等待提交的注册请求
+    std::mutex _mtx;
+    std::condition_variable _cond;
+    std::unique_ptr<std::thread> _commit_thread;
+};
+
+#endif
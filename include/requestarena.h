@@ -0,0 +1,52 @@
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <memory_resource>
+#include <stddef.h>
+
+#include "buff.h"
+
+// 请求级内存池（单调分配）
+// 从缓冲区块池取整块内存顺序切分，释放是空操作；一个请求处理完后 Reset 一次性回收，保留第一块给下一个请求。
+// 超过半块的大对象单独向系统申请，Reset 时释放。
+// 同一时刻只有处理该连接的线程使用，不加锁。
+class RequestArena : public std::pmr::memory_resource {
+public:
+    RequestArena();
+    ~RequestArena();
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    // 回收全部内存，保留第一块；使用该内存池的容器必须先放弃各自的内存
+    void Reset();
+
+    // 回收全部内存，第一块也还给块池（连接空闲时调用）
+    void Release();
+
+    // 持有的内存字节数（块和大对象）
+    size_t MemoryBytes() const { return _chunk_count * sizeof(BufferChunk) + _large_bytes; }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    // 大对象链表节点，放在大对象内存的开头
+    struct LargeBlock {
+        LargeBlock* next;
+    };
+
+    static const size_t LARGE_HEADER = alignof(std::max_align_t);  // 大对象头部占用，保证对象对齐
+
+    BufferChunk* _head;         // 第一块，Reset 后保留
+    BufferChunk* _current;      // 正在切分的块
+    size_t _offset;             // 当前块已用字节数
+    size_t _chunk_count;
+    LargeBlock* _large;         // 单独申请的大对象
+    size_t _large_bytes;        // 大对象总字节数
+};
+
+#endif
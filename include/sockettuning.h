@@ -0,0 +1,41 @@
+#ifndef SOCKET_TUNING_H
+#define SOCKET_TUNING_H
+
+// 套接字调优
+// 监听队列长度和 TCP 选项由 [socket] 配置；选项都设置在监听套接字上，
+// Linux 下 accept 得到的连接套接字会继承（TCP_NODELAY、收发缓冲区、busy poll），新连接不再逐个 setsockopt；
+// 一次写不完的大响应用 TCP_CORK 塞住套接字，写完再拔塞，关闭 Nagle 后也不会发出零碎的小包
+class SocketTuning {
+public:
+    static SocketTuning* Instance();
+
+    // backlog 为 listen 的排队长度（内核按 somaxconn 截断），deferAcceptSec 为 0 关闭 TCP_DEFER_ACCEPT，
+    // fastOpenQueue 为 0 关闭 TCP Fast Open，rcvBuf、sndBuf 为 0 使用系统自动调整，busyPollUs 为 0 关闭 busy poll
+    void Init(int backlog, bool noDelay, bool cork, int deferAcceptSec, int fastOpenQueue,
+        int rcvBuf, int sndBuf, int busyPollUs);
+
+    // 在 listen 之前设置监听套接字的选项，可选项失败只记录日志
+    void ApplyListen(int fd) const;
+
+    int Backlog() const { return _backlog; }
+
+    // 是否对大响应使用 TCP_CORK
+    bool Cork() const { return _cork; }
+
+    // 塞住或拔塞套接字
+    static void SetCork(int fd, bool on);
+
+private:
+    SocketTuning();
+
+    int _backlog;
+    bool _no_delay;
+    bool _cork;
+    int _defer_accept_sec;
+    int _fast_open_queue;
+    int _rcv_buf;
+    int _snd_buf;
+    int _busy_poll_us;
+};
+
+#endif
@@ -15,6 +15,13 @@ public:
         _connpool = connpool;
     }
 
+    // 没有空闲连接时最多等待 timeoutMs 毫秒
+    SqlConnRAII(SqlConnPool* connpool, int timeoutMs) {
+        assert(connpool);
+        _sql = connpool->GetConn(timeoutMs);
+        _connpool = connpool;
+    }
+
     // 析构函数，在对象析构时释放数据库连接
     ~SqlConnRAII() {
         if (_sql) {
@@ -35,6 +42,39 @@ public:
         return true;  // 执行成功
     }
 
+    // 连接是否可用
+    bool IsValid() const { return _sql != nullptr; }
+
+    // 开启事务（关闭自动提交）
+    bool Begin() {
+        if (!_sql) return false;
+        return mysql_autocommit(_sql, 0) == 0;
+    }
+
+    // 提交事务并恢复自动提交
+    bool Commit() {
+        if (!_sql) return false;
+        bool ok = mysql_commit(_sql) == 0;
+        mysql_autocommit(_sql, 1);
+        return ok;
+    }
+
+    // 回滚事务并恢复自动提交
+    void Rollback() {
+        if (!_sql) return;
+        mysql_rollback(_sql);
+        mysql_autocommit(_sql, 1);
+    }
+
+    // 转义字符串，用于拼接 SQL 语句
+    std::string Escape(const std::string& str) {
+        if (!_sql) return str;
+        std::string out(str.size() * 2 + 1, '\0');
+        unsigned long len = mysql_real_escape_string(_sql, &out[0], str.c_str(), str.size());
+        out.resize(len);
+        return out;
+    }
+
     // 执行 SQL 查询，并返回结果集
     std::vector<std::vector<std::string>> Query(const std::string& query) {
         std::vector<std::vector<std::string>> result;
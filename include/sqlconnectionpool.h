@@ -15,6 +15,9 @@ public:
     // 获取一个数据库连接
     MYSQL* GetConn();
 
+    // 获取一个数据库连接，没有空闲连接时最多等待 timeoutMs 毫秒
+    MYSQL* GetConn(int timeoutMs);
+
     // 释放数据库连接
     void FreeConn(MYSQL* conn);
 
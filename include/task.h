@@ -0,0 +1,98 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+#include <assert.h>
+
+// 线程池任务类型
+// 只能移动、不能拷贝，可调用对象直接构造在对象内部的固定大小缓冲区里，构造和移动都不会申请堆内存；
+// 可调用对象超过 INLINE_SIZE 会在编译期报错
+class Task {
+public:
+    static const size_t INLINE_SIZE = 48;
+
+    Task() noexcept : _ops(nullptr) {}
+
+    template<class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) : _ops(nullptr) {
+        Emplace(std::forward<F>(f));
+    }
+
+    Task(Task&& other) noexcept : _ops(nullptr) {
+        MoveFrom(other);
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { Reset(); }
+
+    // 在内部缓冲区构造可调用对象
+    template<class F>
+    void Emplace(F&& f) {
+        typedef typename std::decay<F>::type Fn;
+        static_assert(sizeof(Fn) <= INLINE_SIZE, "Task: 可调用对象超过内联缓冲区大小");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "Task: 可调用对象对齐要求过高");
+        Reset();
+        new (_storage) Fn(std::forward<F>(f));
+        _ops = &Ops<Fn>::table;
+    }
+
+    // 执行任务
+    void operator()() {
+        assert(_ops);
+        _ops->invoke(_storage);
+    }
+
+    // 销毁可调用对象
+    void Reset() {
+        if (_ops) {
+            _ops->destroy(_storage);
+            _ops = nullptr;
+        }
+    }
+
+    explicit operator bool() const { return _ops != nullptr; }
+
+private:
+    struct OpsTable {
+        void (*invoke)(void* self);
+        void (*move)(void* dst, void* src);     // 移动构造到 dst 并销毁 src
+        void (*destroy)(void* self);
+    };
+
+    template<class Fn>
+    struct Ops {
+        static void Invoke(void* self) { (*static_cast<Fn*>(self))(); }
+        static void Move(void* dst, void* src) {
+            new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        }
+        static void Destroy(void* self) { static_cast<Fn*>(self)->~Fn(); }
+        static constexpr OpsTable table = { &Invoke, &Move, &Destroy };
+    };
+
+    void MoveFrom(Task& other) {
+        if (other._ops) {
+            other._ops->move(_storage, other._storage);
+            _ops = other._ops;
+            other._ops = nullptr;
+        }
+    }
+
+    const OpsTable* _ops;
+    alignas(std::max_align_t) unsigned char _storage[INLINE_SIZE];
+};
+
+#endif
@@ -3,28 +3,201 @@
 
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
 #include <thread>
 #include <functional>
+#include <chrono>
+#include <assert.h>
+#include <stdint.h>
+#include <type_traits>
+
+#include "task.h"
+
+// 工作窃取线程池
+// 每个工作线程有自己的无锁双端队列：自己从底部取（LIFO，缓存友好），其他线程从顶部偷（FIFO）；
+// 反应堆线程提交的任务进入一个无锁的注入队列；空闲线程先自旋一段时间，再挂起等待；
+// 可选按排队时延卸载（CoDel）：任务入队时记下时间，工作线程取出时算排队时延，
+// 一个观察窗口内的最小时延都超过目标值说明队列积压，下一个窗口里排队超过两倍目标的任务标记为卸载，
+// 由任务自己查询 Shedding() 后走快速失败路径；积压期间新任务改进后进先出的栈，优先处理刚到的任务（adaptive LIFO），
+// 老任务留在注入队列里，轮到时已经超时被卸载
+
+// Chase-Lev 无锁双端队列（固定容量），只有所属线程 Push/Pop，任意线程 Steal
+template<class T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t capacity = 1024): _top(0), _bottom(0) {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);   // 容量必须是 2 的幂
+        _mask = capacity - 1;
+        _buffer.reset(new std::atomic<T*>[capacity]);
+    }
+
+    // 所属线程压入底部，队列满返回 false
+    bool Push(T* item) {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t t = _top.load(std::memory_order_acquire);
+        if (b - t > static_cast<int64_t>(_mask)) {
+            return false;
+        }
+        _buffer[b & _mask].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 所属线程从底部弹出，空队列返回 nullptr
+    T* Pop() {
+        int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = _top.load(std::memory_order_relaxed);
+        if (t > b) {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* item = _buffer[b & _mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            // 只剩最后一个元素，与窃取者竞争
+            if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            _bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // 其他线程从顶部窃取，失败返回 nullptr
+    T* Steal() {
+        int64_t t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = _bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        T* item = _buffer[t & _mask].load(std::memory_order_relaxed);
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> _top;
+    alignas(64) std::atomic<int64_t> _bottom;
+    size_t _mask;
+    std::unique_ptr<std::atomic<T*>[]> _buffer;
+};
+
+// 有界无锁多生产者多消费者队列（Vyukov），用作注入队列
+template<class T>
+class MpmcQueue {
+public:
+    explicit MpmcQueue(size_t capacity = 4096): _head(0), _tail(0) {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);   // 容量必须是 2 的幂
+        _mask = capacity - 1;
+        _cells.reset(new Cell[capacity]);
+        for (size_t i = 0; i < capacity; i++) {
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // 入队，队列满返回 false
+    bool Push(const T& item) {
+        size_t pos = _tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 出队，队列空返回 false
+    bool Pop(T& item) {
+        size_t pos = _head.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->data;
+        cell->seq.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+    alignas(64) std::atomic<size_t> _head;
+    alignas(64) std::atomic<size_t> _tail;
+    size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+};
 
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t threadCount = 8): _pool(std::make_shared<Pool>()) {
+    // 默认任务槽数量，每个槽保存一个等待执行的任务
+    static const size_t DEFAULT_SLOTS = 4096;
+
+    // 线程启动时的初始化回调，参数为线程序号（用于绑核等）
+    typedef std::function<void(size_t)> ThreadInit;
+
+    explicit ThreadPool(size_t threadCount = 8, size_t slotCount = DEFAULT_SLOTS,
+                        const ThreadInit& init = ThreadInit(), size_t spinCount = 64)
+        : _pool(std::make_shared<Pool>(slotCount)) {
             assert(threadCount > 0);
+            _pool->spinCount = spinCount;
+            for(size_t i = 0; i < threadCount; i++) {
+                _pool->queues.emplace_back(new WorkStealingDeque<TaskSlot>());
+            }
             for(size_t i = 0; i < threadCount; i++) {
-                std::thread([pool = _pool] {
-                    std::unique_lock<std::mutex> locker(pool->mtx);
+                std::thread([pool = _pool, i, init] {
+                    if(init) init(i);
+                    t_pool = pool.get();
+                    t_index = i;
                     while(true) {
-                        if(!pool->tasks.empty()) {
-                            auto task = std::move(pool->tasks.front());
-                            pool->tasks.pop();
-                            locker.unlock();
-                            task();
-                            locker.lock();
-                        } 
-                        else if(pool->isClosed) break;
-                        else pool->cond.wait(locker);
+                        TaskSlot* slot = pool->Take(i);
+                        // 取不到任务先自旋，避免频繁挂起唤醒
+                        for(size_t spin = 0; !slot && spin < pool->spinCount; spin++) {
+                            std::this_thread::yield();
+                            slot = pool->Take(i);
+                        }
+                        if(slot) {
+                            t_shed = pool->codelTarget > 0 && pool->CheckDelay(slot->enqueueUs);
+                            slot->task();
+                            t_shed = false;
+                            pool->Release(slot);
+                            continue;
+                        }
+                        if(!pool->Park()) break;
                     }
+                    t_pool = nullptr;
                 }).detach();
             }
     }
@@ -32,7 +205,7 @@ public:
     ThreadPool() = default;
 
     ThreadPool(ThreadPool&&) = default;
-    
+
     ~ThreadPool() {
         if(static_cast<bool>(_pool)) {
             {
@@ -43,24 +216,236 @@ public:
         }
     }
 
+    // 设置排队任务数上限，0 表示不限制
+    void SetQueueLimit(size_t limit) {
+        _pool->queueLimit = limit;
+    }
+
+    // 按排队时延卸载：targetMs 为排队时延目标，intervalMs 为观察窗口，targetMs 为 0 关闭
+    void SetCodel(int targetMs, int intervalMs) {
+        _pool->codelInterval = static_cast<int64_t>(intervalMs > 0 ? intervalMs : 100) * 1000;
+        _pool->codelTarget = static_cast<int64_t>(targetMs > 0 ? targetMs : 0) * 1000;
+    }
+
+    // 当前线程正在执行的任务是否被标记为卸载（只在工作线程里有意义）
+    static bool Shedding() {
+        return t_shed;
+    }
+
+    // 累计标记为卸载的任务数
+    uint64_t ShedCount() const {
+        return _pool->shedCount.load(std::memory_order_relaxed);
+    }
+
+    // 排队中（尚未被工作线程取走）的任务数
+    size_t QueueSize() const {
+        return _pool->pending.load(std::memory_order_relaxed);
+    }
+
+    // 提交任务，可调用对象直接构造在预分配的任务槽里；排队任务数达到上限时返回 false，任务不会执行
     template<class F>
-    void AddTask(F&& task) {
-        {
-            std::lock_guard<std::mutex> locker(_pool->mtx);
-            _pool->tasks.emplace(std::forward<F>(task));
+    bool AddTask(F&& task) {
+        Pool* pool = _pool.get();
+        if(pool->queueLimit > 0 && pool->pending.load(std::memory_order_relaxed) >= pool->queueLimit) {
+            return false;
+        }
+        TaskSlot* slot = pool->Acquire();
+        if constexpr (std::is_same<typename std::decay<F>::type, Task>::value) {
+            slot->task = std::move(task);
+        }
+        else {
+            slot->task.Emplace(std::forward<F>(task));
         }
-        _pool->cond.notify_one();
+        if(pool->codelTarget > 0) {
+            slot->enqueueUs = Pool::NowUs();
+        }
+        pool->pending.fetch_add(1, std::memory_order_seq_cst);
+        // 工作线程提交的任务放进自己的队列，其余进入注入队列，注入队列满时退回到加锁的溢出队列；积压时进入栈
+        bool local = t_pool == pool && pool->queues[t_index]->Push(slot);
+        if(!local && pool->overloaded.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> locker(pool->mtx);
+            pool->lifo.push_back(slot);
+            pool->lifoCount.fetch_add(1, std::memory_order_release);
+        }
+        else if(!local && !pool->inject.Push(slot)) {
+            std::lock_guard<std::mutex> locker(pool->mtx);
+            pool->overflow.push_back(slot);
+            pool->overflowCount.fetch_add(1, std::memory_order_release);
+        }
+        pool->Wake();
+        return true;
     }
 
 private:
+    // 任务槽
+    struct TaskSlot {
+        Task task;
+        uint32_t index;                     // 在槽数组中的下标，HEAP_SLOT 表示槽用尽时临时申请的
+        int64_t enqueueUs = 0;              // 入队时间（微秒），开启 CoDel 时才记录
+    };
+    static const uint32_t HEAP_SLOT = UINT32_MAX;
+
     struct Pool {
         std::mutex mtx;
         std::condition_variable cond;
-        bool isClosed;
-        std::queue<std::function<void()>> tasks;
+        bool isClosed = false;
+        size_t spinCount = 64;
+        size_t queueLimit = 0;                                          // 排队任务数上限，0 不限制
+
+        std::unique_ptr<TaskSlot[]> slots;                              // 预分配的任务槽
+        MpmcQueue<uint32_t> freeSlots;                                  // 空闲任务槽下标
+        std::vector<std::unique_ptr<WorkStealingDeque<TaskSlot>>> queues;    // 每个工作线程的队列
+        MpmcQueue<TaskSlot*> inject;                                    // 注入队列
+        std::deque<TaskSlot*> overflow;                                 // 注入队列满时的溢出队列（mtx 保护）
+        std::atomic<size_t> overflowCount{0};                           // 溢出队列长度，避免空时加锁
+        std::vector<TaskSlot*> lifo;                                    // 积压期间提交的任务（mtx 保护）
+        std::atomic<size_t> lifoCount{0};
+
+        std::atomic<size_t> pending{0};                                 // 尚未取走的任务数
+        std::atomic<size_t> sleepers{0};                                // 挂起的工作线程数
+
+        int64_t codelTarget = 0;                                        // 排队时延目标（微秒），0 关闭
+        int64_t codelInterval = 100000;                                 // 观察窗口（微秒）
+        std::atomic<int64_t> intervalEnd{0};                            // 当前窗口结束时间
+        std::atomic<int64_t> minDelay{INT64_MAX};                       // 当前窗口内的最小排队时延
+        std::atomic<bool> overloaded{false};                            // 上一个窗口判定为积压
+        std::atomic<uint64_t> shedCount{0};
+
+        explicit Pool(size_t slotCount)
+            : slots(new TaskSlot[RoundUp(slotCount)]), freeSlots(RoundUp(slotCount)), inject(RoundUp(slotCount)) {
+            size_t n = RoundUp(slotCount);
+            for(size_t i = 0; i < n; i++) {
+                slots[i].index = static_cast<uint32_t>(i);
+                freeSlots.Push(static_cast<uint32_t>(i));
+            }
+        }
+
+        // 取一个空闲任务槽，全部用尽时才申请堆内存
+        TaskSlot* Acquire() {
+            uint32_t index;
+            if(freeSlots.Pop(index)) {
+                return &slots[index];
+            }
+            TaskSlot* slot = new TaskSlot;
+            slot->index = HEAP_SLOT;
+            return slot;
+        }
+
+        // 任务执行完归还任务槽
+        void Release(TaskSlot* slot) {
+            slot->task.Reset();
+            if(slot->index == HEAP_SLOT) {
+                delete slot;
+            }
+            else {
+                freeSlots.Push(slot->index);
+            }
+        }
+
+        // 依次从自己的队列、积压栈、注入队列、溢出队列、其他线程的队列取任务
+        TaskSlot* Take(size_t index) {
+            if(pending.load(std::memory_order_acquire) == 0) return nullptr;
+            TaskSlot* slot = queues[index]->Pop();
+            if(!slot && lifoCount.load(std::memory_order_acquire) > 0) {
+                std::lock_guard<std::mutex> locker(mtx);
+                if(!lifo.empty()) {
+                    slot = lifo.back();
+                    lifo.pop_back();
+                    lifoCount.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            if(!slot && !inject.Pop(slot)) {
+                slot = nullptr;
+            }
+            if(!slot && overflowCount.load(std::memory_order_acquire) > 0) {
+                std::lock_guard<std::mutex> locker(mtx);
+                if(!overflow.empty()) {
+                    slot = overflow.front();
+                    overflow.pop_front();
+                    overflowCount.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            if(!slot) {
+                size_t n = queues.size();
+                size_t start = NextRand() % n;
+                for(size_t k = 0; k < n && !slot; k++) {
+                    size_t victim = (start + k) % n;
+                    if(victim != index) slot = queues[victim]->Steal();
+                }
+            }
+            if(slot) pending.fetch_sub(1, std::memory_order_acq_rel);
+            return slot;
+        }
+
+        // 取出任务时更新排队时延统计，返回该任务是否应卸载；多个工作线程并发更新，统计允许有少量误差
+        bool CheckDelay(int64_t enqueueUs) {
+            int64_t now = NowUs();
+            int64_t delay = now - enqueueUs;
+            int64_t end = intervalEnd.load(std::memory_order_relaxed);
+            if(now > end && intervalEnd.compare_exchange_strong(end, now + codelInterval, std::memory_order_relaxed)) {
+                // 窗口结束：窗口内最小时延仍超过目标才算积压；上个窗口里一个任务都没取过（空闲过）不算
+                int64_t lastMin = minDelay.exchange(delay, std::memory_order_relaxed);
+                overloaded.store(now <= end + codelInterval && lastMin > codelTarget, std::memory_order_relaxed);
+            }
+            else {
+                int64_t cur = minDelay.load(std::memory_order_relaxed);
+                while(delay < cur && !minDelay.compare_exchange_weak(cur, delay, std::memory_order_relaxed)) {}
+            }
+            if(overloaded.load(std::memory_order_relaxed) && delay > 2 * codelTarget) {
+                shedCount.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        static int64_t NowUs() {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // 挂起直到有新任务，线程池关闭且没有任务时返回 false
+        bool Park() {
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            std::unique_lock<std::mutex> locker(mtx);
+            cond.wait(locker, [this] { return pending.load(std::memory_order_seq_cst) > 0 || isClosed; });
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            return pending.load(std::memory_order_relaxed) > 0 || !isClosed;
+        }
+
+        // 有挂起的线程时唤醒一个
+        void Wake() {
+            if(sleepers.load(std::memory_order_seq_cst) > 0) {
+                { std::lock_guard<std::mutex> locker(mtx); }
+                cond.notify_one();
+            }
+        }
+
+        // 向上取整到 2 的幂
+        static size_t RoundUp(size_t n) {
+            size_t cap = 1;
+            while(cap < n) cap <<= 1;
+            return cap;
+        }
+
+        static size_t NextRand() {
+            static thread_local size_t seed = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            return seed;
+        }
     };
     std::shared_ptr<Pool> _pool;
+
+    // 当前线程所属的线程池和下标，用于判断任务是否由工作线程提交
+    static thread_local Pool* t_pool;
+    static thread_local size_t t_index;
+    static thread_local bool t_shed;            // 当前执行的任务被标记为卸载
 };
 
+inline thread_local ThreadPool::Pool* ThreadPool::t_pool = nullptr;
+inline thread_local size_t ThreadPool::t_index = 0;
+inline thread_local bool ThreadPool::t_shed = false;
+
 
 #endif
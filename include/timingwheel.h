@@ -0,0 +1,86 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <functional>
+#include <stdint.h>
+#include <assert.h>
+
+// 定时器节点，直接嵌入在连接对象里（侵入式），添加、刷新、删除都不申请内存
+struct TimerNode {
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+    int64_t expires = 0;                    // 到期时间（以 tick 计）
+    void* data = nullptr;                   // 回调参数，一般指向所属的连接
+
+    bool IsLinked() const { return next != nullptr; }
+};
+
+// 分层时间轮
+// 第 0 层 256 个槽，每槽 1 个 tick；第 1~3 层各 64 个槽，每层槽跨度是上一层一圈；
+// 添加、刷新、删除都是 O(1)，推进到下一圈时把高层槽里的节点下放（级联）
+// 时间轮由 timerfd 驱动：timerfd 加入 epoll，可读时调用 tick() 推进到当前时间，只在主循环线程使用
+class TimingWheel {
+public:
+    // 到期回调，所有节点共用
+    typedef std::function<void(TimerNode*)> ExpireCallBack;
+
+    explicit TimingWheel(int tickMs = 10);
+    ~TimingWheel();
+
+    // 设置到期回调
+    void SetCallBack(const ExpireCallBack& cb) { _callback = cb; }
+
+    // timerfd，加入 epoll 监听可读事件
+    int Fd() const { return _timer_fd; }
+
+    // 添加定时器，节点已在时间轮中时刷新到期时间
+    void add(TimerNode* node, int timeoutMs);
+
+    // 刷新定时器到期时间，同 add
+    void adjust(TimerNode* node, int timeoutMs) { add(node, timeoutMs); }
+
+    // 删除定时器
+    void del(TimerNode* node);
+
+    // timerfd 可读时调用：推进到当前时间并执行到期回调
+    void tick();
+
+    // 时间轮中的定时器数量
+    size_t size() const { return _count; }
+
+private:
+    static const int ROOT_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const int ROOT_SIZE = 1 << ROOT_BITS;
+    static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+    static const int ROOT_MASK = ROOT_SIZE - 1;
+    static const int LEVEL_MASK = LEVEL_SIZE - 1;
+    static const int LEVELS = 3;            // 第 0 层以外的层数
+    static const int64_t MAX_TICKS = (int64_t(1) << (ROOT_BITS + LEVELS * LEVEL_BITS)) - 1;
+
+    static void InitList(TimerNode* head) { head->prev = head->next = head; }
+    static void Unlink(TimerNode* node);
+    static void LinkTail(TimerNode* head, TimerNode* node);
+
+    void Place(TimerNode* node);             // 按到期时间放入对应层的槽
+    bool Cascade(int level, int index);      // 把高层一个槽里的节点重新放置，返回 index 是否为 0
+    void RunOneTick();                       // 推进一个 tick
+
+    int64_t NowTick() const;                 // 当前时间对应的 tick（取主循环缓存的时钟）
+    void Arm();                              // 启动 timerfd 周期触发
+    void Disarm();                           // 停止 timerfd
+
+    int _tick_ms;                            // 每个 tick 的毫秒数
+    int _timer_fd;
+    bool _armed;
+    int64_t _start_ms;                       // 时间轮创建时刻（缓存单调时钟毫秒）
+    int64_t _current;                        // 已处理到的 tick
+    size_t _count;
+
+    TimerNode _root[ROOT_SIZE];              // 第 0 层
+    TimerNode _levels[LEVELS][LEVEL_SIZE];   // 第 1~3 层
+
+    ExpireCallBack _callback;
+};
+
+#endif
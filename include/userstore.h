@@ -0,0 +1,28 @@
+#ifndef USER_STORE_H
+#define USER_STORE_H
+
+#include <string>
+
+// 用户存储接口，MysqlOpt 通过它完成登录、注册
+// 返回值约定：Register 0 成功，-1 失败，-2 手机号已存在；Login 0 成功，-1 失败
+class UserStore {
+public:
+    virtual ~UserStore() = default;
+
+    // 注册
+    virtual int Register(const std::string& name, const std::string& phone, const std::string& passwd) = 0;
+
+    // 登录，name 可以是用户名或手机号
+    virtual int Login(const std::string& name, const std::string& passwd) = 0;
+};
+
+// MySQL 存储（默认），使用 SqlConnPool 里的连接
+class MysqlUserStore : public UserStore {
+public:
+    static MysqlUserStore* Instance();
+
+    int Register(const std::string& name, const std::string& phone, const std::string& passwd) override;
+    int Login(const std::string& name, const std::string& passwd) override;
+};
+
+#endif
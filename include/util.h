@@ -61,4 +61,23 @@ static std::string UrlDecode(const std::string& str) {
     }
     return dst;
 }
+
+// 原地解码，解码结果不会比原串长，返回解码后的长度（规则与 UrlDecode 相同）
+static size_t UrlDecode(char* str, size_t length) {
+    size_t j = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (str[i] == '+') {
+            str[j++] = ' ';
+        }
+        else if (i + 2 < length && str[i] == '%') {
+            unsigned char high = FromHex((unsigned char)str[++i]);
+            unsigned char low = FromHex((unsigned char)str[++i]);
+            str[j++] = high * 16 + low;
+        }
+        else {
+            str[j++] = str[i];
+        }
+    }
+    return j;
+}
 };
@@ -1,24 +1,34 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
-#include <unordered_map>
 #include <fcntl.h>      
 #include <unistd.h>     
 #include <assert.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
 #include "configparser.h"
 #include "epoller.h"      
 #include "log.h"
-#include "heaptimer.h"  
+#include "timingwheel.h"
+#include "cachedclock.h"
 #include "sqlconnectionpool.h" 
 #include "threadpool.h"
 #include "sqlconnectionRAII.h"
+#include "registerbatcher.h"
+#include "mysqlopt.h"
+#include "embeddedstore.h"
 #include "httpconnection.h"
 #include "objectpool.h"
+#include "affinity.h"
+#include "admission.h"
+#include "sockettuning.h"
 
 
 class WebServer {
@@ -31,32 +41,41 @@ public:
 
 private:
 
-    // 初始化服务器监听套接字
+    // 初始化服务器监听套接字（TCP 和 Unix 域套接字）
     bool InitSocket();
 
+    // 初始化 TCP 监听套接字
+    bool InitTcpSocket();
+
+    // 初始化 Unix 域监听套接字，同机的反向代理经它转发，省去回环 TCP 的协议栈开销
+    bool InitUnixSocket();
+
     // 根据触发模式初始化事件模式
     void InitEventMode(int trigMode);
 
-    // 向 Epoller 添加客户端连接
-    void AddClient(int fd, sockaddr_in addr);
+    // 向 Epoller 添加客户端连接，connCounted 为准入控制是否计入了该连接
+    void AddClient(int fd, sockaddr_in addr, bool connCounted);
 
     // 处理监听套接字事件
-    void DealListen();
+    void DealListen(int listenFd);
 
     // 处理写事件
-    void DealWrite(HttpConn* client);
+    void DealWrite(HttpConnHot* hot);
 
     // 处理读事件
-    void DealRead(HttpConn* client);
+    void DealRead(HttpConnHot* hot);
 
-    // 发送错误响应
-    void SendError(int fd, const char* info);
+    // 关闭连接
+    void CloseConn(HttpConn* client, bool releaseMemory = true);
 
-    // 延长连接超时时间
-    void ExtenTime(HttpConn* client);
+    // 按当前连接数计算空闲超时
+    int IdleTimeout() const;
 
-    // 关闭连接
-    void CloseConn(HttpConn* client);
+    // 关闭最老的空闲连接，force 为 false 时只关闭空闲超时的
+    void EvictIdle(bool force);
+
+    // 重置连接（发送 RST），用于超时和请求头超限的连接
+    void ResetConn(HttpConn* client, bool releaseMemory = true);
 
     // 处理读事件回调
     void OnRead(HttpConn* client);
@@ -64,11 +83,20 @@ private:
     // 处理写事件回调
     void OnWrite(HttpConn* client);
 
+    // 在主循环线程直接处理读事件
+    void OnReadInline(HttpConn* client);
+
+    // 在主循环线程处理读缓冲区中的请求，流水线上的每个请求都重新判断是否就地处理
+    void ProcessInline(HttpConn* client);
+
     // 处理请求响应
     void OnProcess(HttpConn* client);
 
-    // 设置文件描述符为非阻塞模式
-    static int SetFdNonblock(int fd);
+    // 按路由把请求分到对应的线程池处理
+    void DispatchProcess(HttpConn* client);
+
+    // 把连接的一次处理交给线程池：任务持有连接的引用，开始时连接已关闭就直接放弃；排队已满返回 false
+    bool Submit(ThreadPool* pool, HttpConn* client, void (WebServer::*handler)(HttpConn*));
 
     // 最大文件描述符数量
     int _max_fd;
@@ -77,19 +105,31 @@ private:
 
     int _port;
     bool _open_linger;        // 优雅关闭
-    int _timeout_MS;          // 超时时间（毫秒）
+    bool _inline_fast_path;   // 主循环直接处理静态请求
+    size_t _inline_max_bytes; // 主循环直接处理的静态文件大小上限
+    int _timeout_MS;          // 超时时间（毫秒），不大于 0 时不设超时
+    int _phase_timeout_MS[HttpConn::PHASE_COUNT];  // 各阶段超时时间（毫秒）
+    int _timer_check_MS;      // 定时器最长检查间隔（毫秒）
+    int _idle_pressure_users; // 连接数超过它后空闲超时开始缩短
+    int _idle_min_timeout_MS; // 连接数达到上限时的空闲超时（毫秒）
     bool _is_close;           // 服务器是否关闭
     int _listen_fd;           
+    bool _listen_tcp;         // 是否监听 TCP 端口
+    int _unix_listen_fd;      // Unix 域监听套接字，未启用为 -1
+    std::string _unix_path;   // Unix 域套接字路径，为空不启用
+    int _unix_mode;           // Unix 域套接字文件权限
     char* _src_root_dir;
 
     uint32_t _listen_event;   // 监听事件模式
     uint32_t _conn_event;     // 新连接事件模式
 
-    HeapTimer* _timer;
-    ThreadPool* _thread_pool;
+    TimingWheel* _timer;          // 连接超时时间轮（timerfd 驱动）
+    ThreadPool* _thread_pool;     // 静态资源线程池（读写事件都先进入这里）
+    ThreadPool* _db_pool;         // 数据库线程池（登录、注册）
     Epoller* _epoller;
-    ObjectPool<HttpConn>* _obj_pool;
-    std::unordered_map<int, HttpConn> _users;
+    ObjectPool<HttpConn>* _obj_pool;           // 连接对象池
+    HttpConnHot* _conns;          // 按 fd 下标的连接热数据数组，连接对象按 fd 复用
+    size_t _conn_slots;           // 热数据数组长度（进程可打开的文件描述符上限）
 };
 
 #endif //WEBSERVER_H
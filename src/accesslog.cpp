@@ -0,0 +1,334 @@
+#include "../include/accesslog.h"
+#include "../include/affinity.h"
+#include "../include/cachedclock.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <zlib.h>
+
+using namespace std;
+
+namespace {
+
+// 线程退出时标记环形缓冲区，写线程读空后回收
+struct AccessRingHolder {
+    shared_ptr<LogRing> ring;
+    ~AccessRingHolder() {
+        if (ring) ring->Detach();
+    }
+};
+
+thread_local AccessRingHolder t_access_ring;
+
+const int ACCESS_LINE_MAX = 1024;
+
+// ioprio_set 没有 glibc 封装
+const int IOPRIO_CLASS_SHIFT = 13;
+const int IOPRIO_CLASS_IDLE = 3;
+const int IOPRIO_WHO_PROCESS = 1;
+
+}
+
+AccessLog::AccessLog() {
+    _max_bytes = 64 * 1024 * 1024;
+    _flush_interval_ms = 200;
+    _compress = false;
+    _ring_size = 256 * 1024;
+    _fd = -1;
+    _file_bytes = 0;
+    _is_open = false;
+    _dropped = 0;
+    _wake_pending = false;
+    _stop = false;
+    _compress_stop = false;
+}
+
+AccessLog::~AccessLog() {
+    Close();
+}
+
+// 单例
+AccessLog* AccessLog::Instance() {
+    static AccessLog accessLog;
+    return &accessLog;
+}
+
+bool AccessLog::Open(const string& path, size_t maxBytes, int flushIntervalMs,
+    const string& compress, size_t ringSize) {
+    if (_is_open) return true;
+    _path = path;
+    _max_bytes = maxBytes > 0 ? maxBytes : _max_bytes;
+    _flush_interval_ms = flushIntervalMs > 0 ? flushIntervalMs : _flush_interval_ms;
+    _compress = compress == "gzip";
+    _ring_size = ringSize >= ACCESS_LINE_MAX ? ringSize : ACCESS_LINE_MAX;
+
+    _fd = open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        LOG_ERROR("打开访问日志 %s 失败！", _path.c_str());
+        return false;
+    }
+    struct stat st;
+    _file_bytes = fstat(_fd, &st) == 0 ? st.st_size : 0;
+
+    _stop = false;
+    _compress_stop = false;
+    _flush_thread.reset(new thread(&AccessLog::FlushLoop, this));
+    if (_compress) {
+        _compress_thread.reset(new thread(&AccessLog::CompressLoop, this));
+    }
+    _is_open = true;
+    return true;
+}
+
+void AccessLog::Close() {
+    if (!_is_open.exchange(false)) return;
+    {
+        lock_guard<mutex> locker(_flush_mtx);
+        _stop = true;
+    }
+    _flush_cond.notify_one();
+    if (_flush_thread && _flush_thread->joinable()) {
+        _flush_thread->join();
+    }
+    {
+        lock_guard<mutex> locker(_compress_mtx);
+        _compress_stop = true;
+    }
+    _compress_cond.notify_one();
+    if (_compress_thread && _compress_thread->joinable()) {
+        _compress_thread->join();
+    }
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+void AccessLog::Append(const char* ip, string_view method, string_view path,
+    int status, size_t bytes, int64_t latencyMs) {
+    if (!IsOpen()) return;
+    char line[ACCESS_LINE_MAX];
+    int64_t nowUs = CachedClock::WallUs();
+    int n = snprintf(line, sizeof(line), "%s.%06ld\t%s\t%.*s\t%.*s\t%d\t%zu\t%lld\n",
+        CachedClock::LogPrefix(), static_cast<long>(nowUs % 1000000), ip,
+        static_cast<int>(min(method.size(), static_cast<size_t>(32))), method.data(),
+        static_cast<int>(min(path.size(), static_cast<size_t>(512))), path.data(),
+        status, bytes, static_cast<long long>(latencyMs));
+    if (n <= 0) return;
+    if (n >= ACCESS_LINE_MAX) {
+        n = ACCESS_LINE_MAX - 1;
+        line[n - 1] = '\n';
+    }
+    // 路径里的控制字符替换掉，保证一条记录一行、字段不串
+    for (int i = 0; i < n - 1; i++) {
+        unsigned char c = line[i];
+        if ((c < 0x20 && c != '\t') || c == 0x7f) line[i] = '?';
+    }
+
+    LogRing* ring = LocalRing();
+    if (!ring->TryPush(line, n)) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (ring->Used() * 2 >= ring->Capacity() && !_wake_pending.exchange(true)) {
+        lock_guard<mutex> locker(_flush_mtx);
+        _flush_cond.notify_one();
+    }
+}
+
+LogRing* AccessLog::LocalRing() {
+    if (!t_access_ring.ring) {
+        t_access_ring.ring = make_shared<LogRing>(_ring_size);
+        lock_guard<mutex> locker(_rings_mtx);
+        _rings.push_back(t_access_ring.ring);
+    }
+    return t_access_ring.ring.get();
+}
+
+void AccessLog::FlushLoop() {
+    ThreadAffinity::Instance()->Apply(ThreadAffinity::LOG);
+    uint64_t reported = 0;
+    while (true) {
+        bool stop;
+        {
+            unique_lock<mutex> locker(_flush_mtx);
+            _flush_cond.wait_for(locker, chrono::milliseconds(_flush_interval_ms), [this] {
+                return _wake_pending.load() || _stop;
+            });
+            stop = _stop;
+        }
+        _wake_pending = false;
+        size_t n = FlushRings();
+        uint64_t dropped = _dropped.load(std::memory_order_relaxed);
+        if (dropped != reported) {
+            LOG_WARN("访问日志缓冲区已满，累计丢弃 %llu 行", static_cast<unsigned long long>(dropped));
+            reported = dropped;
+        }
+        if (stop && n == 0) break;
+    }
+}
+
+size_t AccessLog::FlushRings() {
+    {
+        lock_guard<mutex> locker(_rings_mtx);
+        for (size_t i = 0; i < _rings.size();) {
+            if (_rings[i]->IsDetached() && _rings[i]->Used() == 0) {
+                _rings[i] = _rings.back();
+                _rings.pop_back();
+            }
+            else {
+                i++;
+            }
+        }
+        _flush_rings.assign(_rings.begin(), _rings.end());
+    }
+
+    _flush_iov.clear();
+    _flush_bytes.clear();
+    size_t total = 0;
+    for (auto& ring : _flush_rings) {
+        struct iovec iov[2];
+        size_t n = ring->Peek(iov);
+        for (int k = 0; k < 2; k++) {
+            if (iov[k].iov_len > 0) _flush_iov.push_back(iov[k]);
+        }
+        _flush_bytes.push_back(n);
+        total += n;
+    }
+    if (total == 0) return 0;
+
+    // 一次 writev 写入所有线程的缓冲区，处理部分写入
+    const struct iovec* iov = _flush_iov.data();
+    int cnt = static_cast<int>(_flush_iov.size());
+    while (cnt > 0) {
+        ssize_t n = ::writev(_fd, iov, min(cnt, IOV_MAX));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        size_t left = static_cast<size_t>(n);
+        while (cnt > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0 && left > 0) {
+            // 部分写入，剩余部分单独写完
+            const char* p = static_cast<const char*>(iov->iov_base) + left;
+            size_t rest = iov->iov_len - left;
+            while (rest > 0) {
+                ssize_t m = ::write(_fd, p, rest);
+                if (m < 0) {
+                    if (errno == EINTR) continue;
+                    break;
+                }
+                p += m;
+                rest -= m;
+            }
+            if (rest > 0) break;
+            iov++;
+            cnt--;
+        }
+    }
+    for (size_t i = 0; i < _flush_rings.size(); i++) {
+        if (_flush_bytes[i] > 0) _flush_rings[i]->Consume(_flush_bytes[i]);
+    }
+
+    _file_bytes += total;
+    if (_file_bytes >= _max_bytes) {
+        Rotate();
+    }
+    return total;
+}
+
+void AccessLog::Rotate() {
+    // 只有本线程写文件，改名后打开新文件即可，工作线程不受影响
+    time_t now = time(nullptr);
+    struct tm t;
+    localtime_r(&now, &t);
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%04d%02d%02d-%02d%02d%02d",
+        t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+    string rotated = _path + suffix;
+    for (int i = 1; access(rotated.c_str(), F_OK) == 0 || access((rotated + ".gz").c_str(), F_OK) == 0; i++) {
+        rotated = _path + suffix + "-" + to_string(i);
+    }
+    if (rename(_path.c_str(), rotated.c_str()) < 0) {
+        LOG_WARN("访问日志切分失败：%s", rotated.c_str());
+        return;
+    }
+    int fd = open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("打开新的访问日志 %s 失败，继续写入 %s", _path.c_str(), rotated.c_str());
+        return;
+    }
+    close(_fd);
+    _fd = fd;
+    _file_bytes = 0;
+    LOG_INFO("访问日志已切分：%s", rotated.c_str());
+
+    if (_compress) {
+        {
+            lock_guard<mutex> locker(_compress_mtx);
+            _compress_queue.push_back(rotated);
+        }
+        _compress_cond.notify_one();
+    }
+}
+
+void AccessLog::CompressLoop() {
+    // 压缩只在空闲时进行：CPU 调度用 SCHED_IDLE，磁盘 IO 用 idle 优先级
+    struct sched_param param = { 0 };
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+    }
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+
+    while (true) {
+        string file;
+        {
+            unique_lock<mutex> locker(_compress_mtx);
+            _compress_cond.wait(locker, [this] { return !_compress_queue.empty() || _compress_stop; });
+            if (_compress_queue.empty()) break;  // 已关闭且队列已清空
+            file = move(_compress_queue.front());
+            _compress_queue.pop_front();
+        }
+        if (!GzipFile(file)) {
+            LOG_WARN("压缩访问日志 %s 失败", file.c_str());
+        }
+    }
+}
+
+bool AccessLog::GzipFile(const string& src) {
+    int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+    string tmp = src + ".gz.tmp";
+    gzFile out = gzopen(tmp.c_str(), "wb6");
+    if (!out) {
+        close(in);
+        return false;
+    }
+    vector<char> buf(256 * 1024);
+    bool ok = true;
+    ssize_t n;
+    while ((n = ::read(in, buf.data(), buf.size())) > 0) {
+        if (gzwrite(out, buf.data(), static_cast<unsigned>(n)) != n) {
+            ok = false;
+            break;
+        }
+    }
+    if (n < 0) ok = false;
+    close(in);
+    if (gzclose(out) != Z_OK) ok = false;
+    if (!ok || rename(tmp.c_str(), (src + ".gz").c_str()) < 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    unlink(src.c_str());
+    return true;
+}
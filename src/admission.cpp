@@ -0,0 +1,168 @@
+#include "../include/admission.h"
+#include "../include/cachedclock.h"
+#include "../include/log.h"
+
+#include <algorithm>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+Admission::Admission() {
+    _enabled = false;
+    _per_ip_conns = 0;
+    _per_ip_rate = 0;
+    _per_ip_burst = 0;
+    _group_mask = 0;
+    _start_ms = 0;
+    _conn_rate = 0;
+    _conn_burst = 0;
+    _conn_tokens = 0;
+    _conn_last_ms = 0;
+    _rejected = 0;
+    _response_503 = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+}
+
+// 单例
+Admission* Admission::Instance() {
+    static Admission admission;
+    return &admission;
+}
+
+void Admission::Init(size_t tableSize, int perIpConns, int perIpRate, int perIpBurst,
+    int connRate, int connBurst, int retryAfter) {
+    _response_503 = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: " + to_string(max(retryAfter, 1))
+        + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+    _start_ms = CachedClock::MonoMs();
+    _conn_rate = connRate > 0 ? connRate / 1000.0 : 0;
+    _conn_burst = connBurst > 0 ? connBurst : connRate;
+    _conn_tokens = _conn_burst;
+    _conn_last_ms = _start_ms;
+
+    _per_ip_conns = max(perIpConns, 0);
+    _per_ip_rate = perIpRate > 0 ? perIpRate / 1000.0f : 0;
+    _per_ip_burst = perIpBurst > 0 ? perIpBurst : max(perIpRate, 0);
+    _enabled = _per_ip_conns > 0 || _per_ip_rate > 0;
+    if (!_enabled) return;
+
+    size_t groups = 1;
+    while (groups * GROUP_SIZE < tableSize) groups <<= 1;
+    _group_mask = groups - 1;
+    _table.reset(new Entry[groups * GROUP_SIZE]());
+    _locks.reset(new mutex[LOCK_COUNT]);
+}
+
+size_t Admission::Group(uint32_t ip) const {
+    // 乘法哈希，取高位
+    return (static_cast<uint64_t>(ip) * 0x9E3779B97F4A7C15ULL >> 32) & _group_mask;
+}
+
+uint32_t Admission::NowMs() const {
+    return static_cast<uint32_t>(CachedClock::MonoMs() - _start_ms);
+}
+
+void Admission::Refill(Entry* entry, uint32_t now) const {
+    if (_per_ip_rate > 0) {
+        entry->tokens = min(_per_ip_burst, entry->tokens + (now - entry->last_ms) * _per_ip_rate);
+    }
+    entry->last_ms = now;
+}
+
+Admission::Entry* Admission::FindLocked(size_t group, uint32_t ip, uint32_t now) {
+    Entry* begin = &_table[group * GROUP_SIZE];
+    Entry* free = nullptr;
+    for (Entry* entry = begin; entry < begin + GROUP_SIZE; entry++) {
+        if (entry->ip == ip) {
+            Refill(entry, now);
+            return entry;
+        }
+        if (free == nullptr && entry->ip == 0) {
+            free = entry;
+        }
+    }
+    if (free == nullptr) {
+        // 没有空条目：回收没有连接、令牌已补满的条目（等同于新地址）
+        for (Entry* entry = begin; entry < begin + GROUP_SIZE; entry++) {
+            if (entry->conns > 0) continue;
+            Refill(entry, now);
+            if (_per_ip_rate == 0 || entry->tokens >= _per_ip_burst) {
+                free = entry;
+                break;
+            }
+        }
+    }
+    if (free) {
+        free->ip = ip;
+        free->conns = 0;
+        free->tokens = _per_ip_burst;
+        free->last_ms = now;
+    }
+    return free;
+}
+
+bool Admission::AcquireConn(uint32_t ip, bool* counted) {
+    *counted = false;
+    if (_conn_rate > 0) {
+        int64_t now = CachedClock::MonoMs();
+        _conn_tokens = min(_conn_burst, _conn_tokens + (now - _conn_last_ms) * _conn_rate);
+        _conn_last_ms = now;
+        if (_conn_tokens < 1) {
+            _rejected++;
+            return false;
+        }
+        _conn_tokens -= 1;
+    }
+    if (!_enabled || ip == 0) return true;
+    size_t group = Group(ip);
+    lock_guard<mutex> locker(GroupLock(group));
+    Entry* entry = FindLocked(group, ip, NowMs());
+    if (entry == nullptr) {
+        return true;  // 组满，放行不记录
+    }
+    if (_per_ip_conns > 0 && entry->conns >= static_cast<uint32_t>(_per_ip_conns)) {
+        _rejected++;
+        return false;
+    }
+    entry->conns++;
+    *counted = true;
+    return true;
+}
+
+void Admission::ReleaseConn(uint32_t ip) {
+    if (!_enabled || ip == 0) return;
+    size_t group = Group(ip);
+    lock_guard<mutex> locker(GroupLock(group));
+    Entry* begin = &_table[group * GROUP_SIZE];
+    for (Entry* entry = begin; entry < begin + GROUP_SIZE; entry++) {
+        if (entry->ip == ip) {
+            if (entry->conns > 0) entry->conns--;
+            return;
+        }
+    }
+}
+
+bool Admission::AcquireRequest(uint32_t ip) {
+    if (_per_ip_rate == 0 || ip == 0) return true;
+    size_t group = Group(ip);
+    lock_guard<mutex> locker(GroupLock(group));
+    Entry* entry = FindLocked(group, ip, NowMs());
+    if (entry == nullptr) {
+        return true;
+    }
+    if (entry->tokens < 1) {
+        _rejected++;
+        return false;
+    }
+    entry->tokens -= 1;
+    return true;
+}
+
+void Admission::Reject(int fd) {
+    // 新连接的发送缓冲区是空的，503 很短，一次非阻塞发送即可；发送失败也直接关闭
+    ssize_t ret = send(fd, _response_503.data(), _response_503.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (ret < 0) {
+        LOG_WARN_RATE(Log::Instance()->GetSiteRate(), "向客户端[%d]发送 503 失败：%d", fd, errno);
+    }
+    close(fd);
+}
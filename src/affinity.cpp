@@ -0,0 +1,101 @@
+#include "../include/affinity.h"
+#include "../include/log.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+using namespace std;
+
+ThreadAffinity::ThreadAffinity() {
+    for (int i = 0; i < ROLE_COUNT; i++) {
+        _placement[i].policy = SCHED_OTHER;
+        _placement[i].priority = 0;
+    }
+}
+
+// 单例
+ThreadAffinity* ThreadAffinity::Instance() {
+    static ThreadAffinity inst;
+    return &inst;
+}
+
+vector<int> ThreadAffinity::ParseCpuList(const string& cpus) {
+    vector<int> res;
+    size_t pos = 0;
+    while (pos < cpus.size()) {
+        size_t end = cpus.find(',', pos);
+        if (end == string::npos) end = cpus.size();
+        string item = cpus.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.find_first_of("0123456789") == string::npos) continue;
+        size_t dash = item.find('-');
+        int first = atoi(item.c_str());
+        int last = dash == string::npos ? first : atoi(item.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            if (cpu >= 0) res.push_back(cpu);
+        }
+    }
+    return res;
+}
+
+int ThreadAffinity::ParsePolicy(const string& policy) {
+    if (policy.empty() || policy == "other") return SCHED_OTHER;
+    if (policy == "batch") return SCHED_BATCH;
+    if (policy == "idle") return SCHED_IDLE;
+    if (policy == "fifo") return SCHED_FIFO;
+    if (policy == "rr") return SCHED_RR;
+    return -1;
+}
+
+void ThreadAffinity::SetRole(Role role, const string& cpus, const string& policy, int priority) {
+    assert(role >= 0 && role < ROLE_COUNT);
+    lock_guard<mutex> locker(_mtx);
+    _placement[role].cpus = ParseCpuList(cpus);
+    int p = ParsePolicy(policy);
+    if (p < 0) {
+        LOG_WARN("未知的调度策略：%s，使用 other", policy.c_str());
+        p = SCHED_OTHER;
+    }
+    _placement[role].policy = p;
+    _placement[role].priority = priority;
+}
+
+bool ThreadAffinity::Apply(Role role, size_t index) {
+    assert(role >= 0 && role < ROLE_COUNT);
+    Placement placement;
+    {
+        lock_guard<mutex> locker(_mtx);
+        placement = _placement[role];
+    }
+    bool ok = true;
+
+    if (!placement.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (role == WORKER) {
+            // 工作线程各绑一个 CPU，避免在核之间迁移
+            CPU_SET(placement.cpus[index % placement.cpus.size()], &set);
+        }
+        else {
+            for (int cpu : placement.cpus) CPU_SET(cpu, &set);
+        }
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            LOG_WARN("线程[%d]绑定 CPU 失败", role);
+            ok = false;
+        }
+    }
+
+    if (placement.policy != SCHED_OTHER || placement.priority != 0) {
+        struct sched_param param = { 0 };
+        if (placement.policy == SCHED_FIFO || placement.policy == SCHED_RR) {
+            param.sched_priority = placement.priority;
+        }
+        if (pthread_setschedparam(pthread_self(), placement.policy, &param) != 0) {
+            LOG_WARN("线程[%d]设置调度策略失败", role);
+            ok = false;
+        }
+    }
+    return ok;
+}
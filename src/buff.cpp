@@ -1,141 +1,291 @@
 #include "../include/buff.h"
 
-Buffer::Buffer(int initBuffSize) : _buffer(initBuffSize), _read_pos(0), _write_pos(0) {}
+#include <algorithm>
 
-size_t Buffer::ReadableBytes() const {
-    return _write_pos - _read_pos;
+// 从 pos 开始（可跨块）比较 pattern，调用方保证后面至少有 len 个可读字节
+static bool MatchAt(const BufferChunk* chunk, size_t pos, const char* pattern, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (pos == BufferChunk::SIZE) {
+            chunk = chunk->next;
+            pos = 0;
+        }
+        if (chunk->data[pos] != pattern[i]) return false;
+        pos++;
+    }
+    return true;
 }
 
-size_t Buffer::WritableBytes() const {
-    return _buffer.size() - _write_pos;
+// 单例
+BufferChunkPool* BufferChunkPool::Instance() {
+    static BufferChunkPool pool;
+    return &pool;
 }
 
-size_t Buffer::PrependableBytes() const {
-    return _read_pos;
+void BufferChunkPool::Init(size_t initChunks, bool populate, size_t batch) {
+    std::call_once(_init_flag, [&] {
+        _pool.reset(new ObjectPool<BufferChunk>(initChunks, initChunks / 4, populate, batch));
+    });
 }
 
-const char* Buffer::Peek() const {
-    return BeginPtr_() + _read_pos;
+ObjectPool<BufferChunk>* BufferChunkPool::Pool() {
+    // 没有调用 Init 时按默认参数创建
+    Init(256, false, 32);
+    return _pool.get();
 }
 
-void Buffer::Retrieve(size_t len) {
-    assert(len <= ReadableBytes());
-    _read_pos += len;
+void BufferChunkPool::Free(BufferChunk* chunk) {
+    ObjectPool<BufferChunk>* pool = Pool();
+    while (chunk) {
+        BufferChunk* next = chunk->next;
+        pool->Delete(chunk);
+        chunk = next;
+    }
 }
 
-void Buffer::RetrieveUntil(const char* end) {
-    assert(Peek() <= end);
-    Retrieve(end - Peek());
+Buffer::Buffer()
+    : _head(nullptr), _tail(nullptr), _read_pos(0), _write_pos(0), _readable(0), _chunk_count(0) {}
+
+Buffer::~Buffer() {
+    if (_head) {
+        BufferChunkPool::Instance()->Free(_head);
+    }
 }
 
-void Buffer::RetrieveAll() {
-    bzero(&_buffer[0], _buffer.size());
-    _read_pos = 0;
+void Buffer::AppendChunk(BufferChunk* chunk) {
+    chunk->next = nullptr;
+    if (_tail) {
+        _tail->next = chunk;
+    }
+    else {
+        _head = chunk;
+        _read_pos = 0;
+    }
+    _tail = chunk;
     _write_pos = 0;
+    _chunk_count++;
 }
 
-std::string Buffer::RetrieveAllToStr() {
-    std::string str(Peek(), ReadableBytes());
-    RetrieveAll();
+void Buffer::ReleaseHead() {
+    BufferChunk* head = _head;
+    _head = head->next;
+    head->next = nullptr;
+    BufferChunkPool::Instance()->Free(head);
+    _read_pos = 0;
+    _chunk_count--;
+}
+
+size_t Buffer::Find(const char* pattern, size_t len, size_t maxLen) const {
+    assert(pattern && len > 0);
+    size_t limit = std::min(_readable, maxLen);
+    size_t offset = 0;  // 当前块可读部分的开头相对可读数据开头的偏移
+    for (const BufferChunk* chunk = _head; chunk && offset < limit; chunk = chunk->next) {
+        size_t begin = chunk == _head ? _read_pos : 0;
+        size_t end = chunk == _tail ? _write_pos : BufferChunk::SIZE;
+        const char* spanBegin = chunk->data + begin;
+        const char* spanEnd = spanBegin + std::min(end - begin, limit - offset);
+        for (const char* p = spanBegin; p < spanEnd; p++) {
+            p = static_cast<const char*>(memchr(p, pattern[0], spanEnd - p));
+            if (p == nullptr) break;
+            size_t pos = offset + (p - spanBegin);
+            if (pos + len > _readable) return npos;
+            if (MatchAt(chunk, p - chunk->data, pattern, len)) return pos;
+        }
+        offset += end - begin;
+    }
+    return npos;
+}
+
+std::string Buffer::PeekString(size_t len) const {
+    std::string str(len, '\0');
+    PeekCopy(&str[0], len);
     return str;
 }
 
-const char* Buffer::BeginWriteConst() const {
-    return BeginPtr_() + _write_pos;
+void Buffer::PeekCopy(char* dst, size_t len) const {
+    assert(len <= _readable);
+    for (const BufferChunk* chunk = _head; chunk && len > 0; chunk = chunk->next) {
+        size_t begin = chunk == _head ? _read_pos : 0;
+        size_t end = chunk == _tail ? _write_pos : BufferChunk::SIZE;
+        size_t n = std::min(end - begin, len);
+        memcpy(dst, chunk->data + begin, n);
+        dst += n;
+        len -= n;
+    }
 }
 
-char* Buffer::BeginWrite() {
-    return BeginPtr_() + _write_pos;
+void Buffer::Retrieve(size_t len) {
+    assert(len <= _readable);
+    _readable -= len;
+    while (len > 0) {
+        size_t end = _head == _tail ? _write_pos : BufferChunk::SIZE;
+        size_t n = std::min(len, end - _read_pos);
+        _read_pos += n;
+        len -= n;
+        if (_read_pos == end && _head != _tail) {
+            ReleaseHead();
+        }
+    }
+    if (_readable == 0) {
+        // 已读完，只剩一个块，从头开始复用
+        _read_pos = 0;
+        _write_pos = 0;
+    }
 }
 
-void Buffer::HasWritten(size_t len) {
-    _write_pos += len;
+void Buffer::RetrieveAll() {
+    if (_head == nullptr) return;
+    if (_head->next) {
+        BufferChunkPool::Instance()->Free(_head->next);
+        _head->next = nullptr;
+    }
+    _tail = _head;
+    _chunk_count = 1;
+    _read_pos = 0;
+    _write_pos = 0;
+    _readable = 0;
+}
+
+void Buffer::Release() {
+    if (_head) {
+        BufferChunkPool::Instance()->Free(_head);
+    }
+    _head = nullptr;
+    _tail = nullptr;
+    _chunk_count = 0;
+    _read_pos = 0;
+    _write_pos = 0;
+    _readable = 0;
+}
+
+std::string Buffer::RetrieveAllToStr() {
+    std::string str = PeekString(_readable);
+    RetrieveAll();
+    return str;
 }
 
 void Buffer::Append(const std::string& str) {
     Append(str.data(), str.length());
 }
 
+void Buffer::Append(std::string_view str) {
+    Append(str.data(), str.size());
+}
+
+void Buffer::Append(const char* str) {
+    Append(str, strlen(str));
+}
+
 void Buffer::Append(const void* data, size_t len) {
     assert(data);
     Append(static_cast<const char*>(data), len);
 }
 
 void Buffer::Append(const char* str, size_t len) {
-    assert(str);
-    EnsureWriteable(len);
-    std::copy(str, str + len, BeginWrite());
-    HasWritten(len);
+    assert(str || len == 0);
+    _readable += len;
+    while (len > 0) {
+        if (TailWritable() == 0) {
+            AppendChunk(BufferChunkPool::Instance()->Alloc());
+        }
+        size_t n = std::min(len, TailWritable());
+        memcpy(_tail->data + _write_pos, str, n);
+        _write_pos += n;
+        str += n;
+        len -= n;
+    }
 }
 
 void Buffer::Append(const Buffer& buff) {
-    Append(buff.Peek(), buff.ReadableBytes());
-}
-
-void Buffer::EnsureWriteable(size_t len) {
-    if (WritableBytes() < len) {
-        MakeSpace_(len);
+    for (const BufferChunk* chunk = buff._head; chunk; chunk = chunk->next) {
+        size_t begin = chunk == buff._head ? buff._read_pos : 0;
+        size_t end = chunk == buff._tail ? buff._write_pos : BufferChunk::SIZE;
+        Append(chunk->data + begin, end - begin);
     }
-    assert(WritableBytes() >= len);
 }
 
 ssize_t Buffer::ReadFd(int fd, int* saveErrno) {
-    char buff[65535];
-    struct iovec iov[2];
-    const size_t writable = WritableBytes();
-    /* 分散读， 保证数据全部读完 */
-    iov[0].iov_base = BeginPtr_() + _write_pos;
-    iov[0].iov_len = writable;
-    iov[1].iov_base = buff;
-    iov[1].iov_len = sizeof(buff);
-
-    const ssize_t len = readv(fd, iov, 2);  // 使用readv进行分散读取
+    // 分散读：先填尾块剩余空间，再预取几个新块接着读，没用上的块归还块池
+    BufferChunkPool* pool = BufferChunkPool::Instance();
+    struct iovec iov[READ_CHUNKS + 1];
+    BufferChunk* extra[READ_CHUNKS];
+    int cnt = 0;
+    const size_t writable = TailWritable();
+    if (writable > 0) {
+        iov[cnt].iov_base = _tail->data + _write_pos;
+        iov[cnt].iov_len = writable;
+        cnt++;
+    }
+    for (int i = 0; i < READ_CHUNKS; i++) {
+        extra[i] = pool->Alloc();
+        iov[cnt].iov_base = extra[i]->data;
+        iov[cnt].iov_len = BufferChunk::SIZE;
+        cnt++;
+    }
+
+    const ssize_t len = readv(fd, iov, cnt);
+    int used = 0;
     if (len < 0) {
         *saveErrno = errno;
     }
-    // 缓冲区未满
-    else if (static_cast<size_t>(len) <= writable) {
-        _write_pos += len;
-    }
-    // 缓冲区满，将buff数据移动数据到缓冲区
     else {
-        _write_pos = _buffer.size();
-        Append(buff, len - writable);
+        size_t left = static_cast<size_t>(len);
+        size_t n = std::min(left, writable);
+        _write_pos += n;
+        left -= n;
+        while (left > 0) {
+            AppendChunk(extra[used++]);
+            n = std::min(left, BufferChunk::SIZE);
+            _write_pos = n;
+            left -= n;
+        }
+        _readable += len;
+    }
+    // 没用上的块串起来一次归还
+    BufferChunk* unused = nullptr;
+    for (int i = READ_CHUNKS - 1; i >= used; i--) {
+        extra[i]->next = unused;
+        unused = extra[i];
+    }
+    if (unused) {
+        pool->Free(unused);
     }
     return len;
 }
 
-ssize_t Buffer::WriteFd(int fd, int* saveErrno) {
-    size_t readSize = ReadableBytes();
-    ssize_t len = write(fd, Peek(), readSize);  // 使用write写入数据到文件描述符
+ssize_t Buffer::WriteFd(int fd, int* saveErrno, struct iovec* tail) {
+    // 聚集写：由块链表构造 iovec，数据不需要先拼成连续内存
+    struct iovec iov[WRITE_IOV_MAX + 1];
+    int cnt = 0;
+    const BufferChunk* chunk = _head;
+    for (; chunk && cnt < WRITE_IOV_MAX; chunk = chunk->next) {
+        size_t begin = chunk == _head ? _read_pos : 0;
+        size_t end = chunk == _tail ? _write_pos : BufferChunk::SIZE;
+        if (end > begin) {
+            iov[cnt].iov_base = const_cast<char*>(chunk->data) + begin;
+            iov[cnt].iov_len = end - begin;
+            cnt++;
+        }
+    }
+    // 缓冲区数据全部放入后才能接上 tail，保证写出顺序
+    if (chunk == nullptr && tail && tail->iov_len > 0) {
+        iov[cnt++] = *tail;
+    }
+    if (cnt == 0) {
+        return 0;
+    }
+
+    const ssize_t len = writev(fd, iov, cnt);
     if (len < 0) {
         *saveErrno = errno;
         return len;
     }
-    _read_pos += len;
-    return len;
-}
-
-char* Buffer::BeginPtr_() {
-    return &*_buffer.begin();
-}
-
-const char* Buffer::BeginPtr_() const {
-    return &*_buffer.begin();
-}
-
-void Buffer::MakeSpace_(size_t len) {
-    // 缓冲区容量不足直接扩容
-    if (WritableBytes() + PrependableBytes() < len) {
-        _buffer.resize(_write_pos + len + 1);
-    }
-    // 缓冲区容量足够，将数据前移
-    else {
-        size_t readable = ReadableBytes();
-        std::copy(BeginPtr_() + _read_pos, BeginPtr_() + _write_pos, BeginPtr_());
-        _read_pos = 0;
-        _write_pos = _read_pos + readable;
-        assert(readable == ReadableBytes());
+    size_t left = static_cast<size_t>(len);
+    size_t n = std::min(left, _readable);
+    Retrieve(n);
+    left -= n;
+    if (left > 0) {
+        tail->iov_base = static_cast<char*>(tail->iov_base) + left;
+        tail->iov_len -= left;
     }
+    return len;
 }
-
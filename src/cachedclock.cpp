@@ -0,0 +1,89 @@
+#include "../include/cachedclock.h"
+
+#include <time.h>
+#include <stdio.h>
+
+std::atomic<int64_t> CachedClock::_mono_ms(0);
+std::atomic<int64_t> CachedClock::_wall_us(0);
+thread_local bool CachedClock::t_owner = false;
+
+namespace {
+
+// 每个线程自己的格式化缓存，只在秒数变化时重新格式化
+struct FormatCache {
+    int64_t log_sec = -1;
+    int log_mday = 0;
+    char log_prefix[72];
+
+    int64_t date_sec = -1;
+    char http_date[32];
+};
+
+thread_local FormatCache t_cache;
+
+const char* const WEEK_DAYS[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+const char* const MONTHS[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+int64_t ReadMonoMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+int64_t ReadWallUs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+}
+
+void CachedClock::Update() {
+    t_owner = true;
+    _mono_ms.store(ReadMonoMs(), std::memory_order_relaxed);
+    _wall_us.store(ReadWallUs(CLOCK_REALTIME), std::memory_order_relaxed);
+}
+
+int64_t CachedClock::MonoMs() {
+    if (!t_owner) {
+        return ReadMonoMs();  // 不在主循环线程（或主循环还没启动），缓存值可能已过期
+    }
+    return _mono_ms.load(std::memory_order_relaxed);
+}
+
+int64_t CachedClock::WallUs() {
+    if (!t_owner) {
+        return ReadWallUs(CLOCK_REALTIME_COARSE);
+    }
+    return _wall_us.load(std::memory_order_relaxed);
+}
+
+const char* CachedClock::LogPrefix(int* mday) {
+    FormatCache& cache = t_cache;
+    int64_t sec = WallUs() / 1000000;
+    if (sec != cache.log_sec) {
+        time_t tSec = static_cast<time_t>(sec);
+        struct tm t;
+        localtime_r(&tSec, &t);
+        snprintf(cache.log_prefix, sizeof(cache.log_prefix), "%d-%02d-%02d %02d:%02d:%02d",
+            t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+        cache.log_mday = t.tm_mday;
+        cache.log_sec = sec;
+    }
+    if (mday) *mday = cache.log_mday;
+    return cache.log_prefix;
+}
+
+const char* CachedClock::HttpDate() {
+    FormatCache& cache = t_cache;
+    int64_t sec = WallUs() / 1000000;
+    if (sec != cache.date_sec) {
+        time_t tSec = static_cast<time_t>(sec);
+        struct tm t;
+        gmtime_r(&tSec, &t);
+        snprintf(cache.http_date, sizeof(cache.http_date), "%s, %02d %s %d %02d:%02d:%02d GMT",
+            WEEK_DAYS[t.tm_wday], t.tm_mday, MONTHS[t.tm_mon], t.tm_year + 1900, t.tm_hour, t.tm_min, t.tm_sec);
+        cache.date_sec = sec;
+    }
+    return cache.http_date;
+}
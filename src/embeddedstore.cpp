@@ -0,0 +1,215 @@
+#include "../include/embeddedstore.h"
+#include "../include/log.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <mutex>
+
+using namespace std;
+
+static const char STORE_MAGIC[8] = { 'W', 'S', 'U', 'S', 'E', 'R', '0', '1' };
+
+EmbeddedUserStore::EmbeddedUserStore() {
+    _fd = -1;
+    _base = nullptr;
+    _capacity = 0;
+    _grow_size = 4 * 1024 * 1024;
+}
+
+EmbeddedUserStore::~EmbeddedUserStore() {
+    Close();
+}
+
+// 单例
+EmbeddedUserStore* EmbeddedUserStore::Instance() {
+    static EmbeddedUserStore store;
+    return &store;
+}
+
+bool EmbeddedUserStore::Open(const string& path, size_t growSize) {
+    unique_lock<shared_mutex> locker(_mtx);
+    assert(_fd < 0 && growSize > sizeof(FileHeader));
+    _grow_size = growSize;
+    _fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        LOG_ERROR("用户存储文件 %s 打开失败！", path.c_str());
+        return false;
+    }
+
+    struct stat st;
+    fstat(_fd, &st);
+    size_t size = st.st_size;
+    if (size < sizeof(FileHeader)) {
+        // 新文件：预分配一段空间并写入文件头
+        size = _grow_size;
+        if (ftruncate(_fd, size) < 0) {
+            LOG_ERROR("用户存储文件 %s 预分配失败！", path.c_str());
+            close(_fd);
+            _fd = -1;
+            return false;
+        }
+    }
+
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (addr == MAP_FAILED) {
+        LOG_ERROR("用户存储文件 %s 映射失败！", path.c_str());
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+    _base = static_cast<char*>(addr);
+    _capacity = size;
+
+    FileHeader* header = reinterpret_cast<FileHeader*>(_base);
+    if (memcmp(header->magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0) {
+        if (header->used != 0) {
+            LOG_ERROR("用户存储文件 %s 格式错误！", path.c_str());
+            munmap(_base, _capacity);
+            close(_fd);
+            _base = nullptr;
+            _fd = -1;
+            return false;
+        }
+        memcpy(header->magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+        header->used = sizeof(FileHeader);
+    }
+    return Replay();
+}
+
+void EmbeddedUserStore::Close() {
+    unique_lock<shared_mutex> locker(_mtx);
+    if (_base) {
+        msync(_base, _capacity, MS_SYNC);
+        munmap(_base, _capacity);
+        _base = nullptr;
+    }
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    _phone_index.clear();
+    _name_index.clear();
+}
+
+bool EmbeddedUserStore::Replay() {
+    FileHeader* header = reinterpret_cast<FileHeader*>(_base);
+    if (header->used < sizeof(FileHeader) || header->used > _capacity) {
+        // 文件头损坏或文件被截断：used 不能超出映射范围，否则读记录时越界
+        LOG_WARN("用户存储已用长度 %lu 超出文件范围 %lu，已截断", (unsigned long)header->used, (unsigned long)_capacity);
+        header->used = header->used < sizeof(FileHeader) ? sizeof(FileHeader) : _capacity;
+    }
+    uint64_t off = sizeof(FileHeader);
+    while (off + sizeof(RecordHeader) <= header->used) {
+        RecordHeader rec;
+        memcpy(&rec, _base + off, sizeof(rec));
+        if (rec.len < sizeof(RecordHeader) || off + rec.len > header->used ||
+            sizeof(RecordHeader) + rec.name_len + rec.phone_len + rec.passwd_len != rec.len) {
+            // 记录不完整或各段长度与记录长度不符，截断到最后一条完整记录
+            LOG_WARN("用户存储在偏移 %lu 处记录损坏，已截断", (unsigned long)off);
+            header->used = off;
+            break;
+        }
+        IndexRecord(off);
+        off += rec.len;
+    }
+    LOG_INFO("用户存储加载完成，记录数：%d", (int)_phone_index.size());
+    return true;
+}
+
+void EmbeddedUserStore::IndexRecord(uint64_t off) {
+    RecordHeader rec;
+    memcpy(&rec, _base + off, sizeof(rec));
+    const char* data = _base + off + sizeof(RecordHeader);
+    _name_index.emplace(string(data, rec.name_len), off);
+    _phone_index[string(data + rec.name_len, rec.phone_len)] = off;
+}
+
+bool EmbeddedUserStore::CheckPasswd(uint64_t off, const string& passwd) const {
+    RecordHeader rec;
+    memcpy(&rec, _base + off, sizeof(rec));
+    const char* data = _base + off + sizeof(RecordHeader) + rec.name_len + rec.phone_len;
+    return rec.passwd_len == passwd.size() && memcmp(data, passwd.data(), passwd.size()) == 0;
+}
+
+bool EmbeddedUserStore::Grow(size_t need) {
+    size_t newCapacity = _capacity;
+    while (newCapacity < need) {
+        newCapacity += _grow_size;
+    }
+    if (ftruncate(_fd, newCapacity) < 0) {
+        return false;
+    }
+    void* addr = mremap(_base, _capacity, newCapacity, MREMAP_MAYMOVE);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    _base = static_cast<char*>(addr);
+    _capacity = newCapacity;
+    return true;
+}
+
+int EmbeddedUserStore::Register(const string& name, const string& phone, const string& passwd) {
+    if (name.size() > UINT16_MAX || phone.size() > UINT16_MAX || passwd.size() > UINT16_MAX) {
+        return -1;
+    }
+    unique_lock<shared_mutex> locker(_mtx);
+    if (!_base) return -1;
+    if (_phone_index.count(phone)) {
+        LOG_DEBUG("手机号已存在,注册失败");
+        return -2;
+    }
+
+    RecordHeader rec;
+    rec.len = sizeof(RecordHeader) + name.size() + phone.size() + passwd.size();
+    rec.name_len = name.size();
+    rec.phone_len = phone.size();
+    rec.passwd_len = passwd.size();
+    rec.reserved = 0;
+
+    uint64_t off = reinterpret_cast<FileHeader*>(_base)->used;
+    if (off + rec.len > _capacity && !Grow(off + rec.len)) {
+        LOG_WARN("用户存储扩容失败，注册失败");
+        return -1;
+    }
+
+    // 先写记录再推进 used，中途崩溃只会丢掉这一条
+    char* dst = _base + off;
+    memcpy(dst, &rec, sizeof(rec));
+    dst += sizeof(rec);
+    memcpy(dst, name.data(), name.size());
+    dst += name.size();
+    memcpy(dst, phone.data(), phone.size());
+    dst += phone.size();
+    memcpy(dst, passwd.data(), passwd.size());
+    reinterpret_cast<FileHeader*>(_base)->used = off + rec.len;
+
+    IndexRecord(off);
+    LOG_DEBUG("name:%s,phone:%s注册成功！", name.c_str(), phone.c_str());
+    return 0;
+}
+
+int EmbeddedUserStore::Login(const string& name, const string& passwd) {
+    shared_lock<shared_mutex> locker(_mtx);
+    if (!_base) return -1;
+    // 与 MySQL 一致：用户名或手机号匹配且密码正确
+    auto it = _phone_index.find(name);
+    if (it != _phone_index.end() && CheckPasswd(it->second, passwd)) {
+        return 0;
+    }
+    auto range = _name_index.equal_range(name);
+    for (auto nit = range.first; nit != range.second; ++nit) {
+        if (CheckPasswd(nit->second, passwd)) {
+            return 0;
+        }
+    }
+    LOG_DEBUG("%s登录失败", name.c_str());
+    return -1;
+}
+
+size_t EmbeddedUserStore::Size() {
+    shared_lock<shared_mutex> locker(_mtx);
+    return _phone_index.size();
+}
@@ -1,43 +1,170 @@
 #include "../include/httpconnection.h"
+#include "../include/threadpool.h"
+#include "../include/sockettuning.h"
+#include <algorithm>
 using namespace std;
 
 const char* HttpConn::_src_dir;
 std::atomic<int> HttpConn::_user_count;
 bool HttpConn::_is_ET;
+int HttpConn::_keep_alive_max = 0;
+std::mutex HttpConn::_idle_mtx;
+HttpConn* HttpConn::_idle_head = nullptr;
+HttpConn* HttpConn::_idle_tail = nullptr;
+size_t HttpConn::_idle_count = 0;
+std::unordered_map<size_t, HttpConn::StaticProbe> HttpConn::_static_probes;
 
-HttpConn::HttpConn() { 
-    _fd = -1;
+HttpConn::HttpConn() : _request(&_arena) { 
+    _hot = nullptr;
     _addr = { 0 };
-    _is_close = true;
+    _request_start_ms = 0;
+    _response_bytes = 0;
+    _phase = IDLE;
+    _phase_start_ms = 0;
+    _request_count = 0;
+    _corked = false;
+    _conn_counted = false;
+    _idle_prev = _idle_next = nullptr;
+    _idle_linked = false;
+    _gen = 0;
+    _state = CLOSING;  // 还没有初始化，析构时不关闭
 };
 
 HttpConn::~HttpConn() { 
     Close(); 
 };
 
-void HttpConn::init(int fd, const sockaddr_in& addr) {
-    assert(fd > 0);
+void HttpConn::init(HttpConnHot* hot, int fd, const sockaddr_in& addr, bool connCounted) {
+    assert(hot && fd > 0);
+    // 与上一个连接最后一个任务的 Unref 同步：描述符关闭后才会被 accept 复用，这里才能重写连接对象
+    uint32_t state = _state.load(std::memory_order_acquire);
+    assert(state == CLOSING);
+    (void)state;
     _user_count++;
     _addr = addr;
-    _fd = fd;
+    _conn_counted = connCounted;
+    _hot = hot;
+    _hot->conn = this;
+    _hot->fd = fd;
+    _hot->timer.data = _hot;
     write_buff.RetrieveAll();
     read_buff.RetrieveAll();
-    _is_close = false;
-    LOG_INFO("Client[%d](%s:%d) in, _user_count:%d", _fd, GetIP(), GetPort(), (int)_user_count);
+    _request.Init();
+    _arena.Reset();
+    _hot->file_iov = { nullptr, 0 };
+    _request_start_ms = 0;
+    _response_bytes = 0;
+    _request_count = 0;
+    _corked = false;
+    _phase_start_ms.store(CachedClock::MonoMs(), std::memory_order_relaxed);
+    _phase.store(READ_HEADER, std::memory_order_release);  // 新连接的第一个请求按请求头期限计时
+    _state.store(0, std::memory_order_release);
+    _hot->is_close = false;
+    LOG_INFO_RATE(Log::Instance()->GetSiteRate(), "Client[%d](%s:%d) in, _user_count:%d", fd, GetIP(), GetPort(), (int)_user_count);
 }
 
 void HttpConn::Close() {
+    uint32_t state = _state.fetch_or(CLOSING, std::memory_order_acq_rel);
+    if (state & CLOSING) {
+        return;  // 已经关闭过
+    }
+    _gen.fetch_add(1, std::memory_order_release);  // 排队中的任务开始时发现代数变了，不再处理
+    UnlinkIdle();
+    _hot->is_close = true;
+    _user_count--;
+    if (_conn_counted) {
+        Admission::Instance()->ReleaseConn(_addr.sin_addr.s_addr);  // 组满放行的连接没有计入，不能减掉同一 IP 其他连接的计数
+    }
+    LOG_INFO_RATE(Log::Instance()->GetSiteRate(), "Client[%d](%s:%d) quit, UserCount:%d", _hot->fd, GetIP(), GetPort(), (int)_user_count);
+    if (state == 0) {
+        Finish();  // 没有任务引用，立即关闭描述符
+    }
+}
+
+void HttpConn::Unref() {
+    uint32_t state = _state.fetch_sub(1, std::memory_order_acq_rel);
+    assert((state & ~CLOSING) > 0);
+    if (state == (CLOSING | 1)) {
+        Finish();  // 连接已关闭，最后一个引用它的任务结束
+    }
+}
+
+void HttpConn::Finish() {
+    // 文件映射和描述符都可能正被任务使用，等没有引用时才释放；描述符关闭后才可能被新连接复用
+    int fd = _hot->fd;
     _response.UnmapFile();
-    if(_is_close == false){
-        _is_close = true; 
-        _user_count--;
-        close(_fd);
-        LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", _fd, GetIP(), GetPort(), (int)_user_count);
+    _state.store(CLOSING, std::memory_order_release);  // 复用连接对象的 init 从这里同步，之后不再访问连接对象
+    close(fd);
+}
+
+void HttpConn::EnterPhase(CONN_PHASE phase) {
+    CONN_PHASE old = _phase.load(std::memory_order_relaxed);
+    if (old != phase) {
+        if (old == IDLE) {
+            UnlinkIdle();
+        }
+        if (phase == IDLE) {
+            LinkIdle();  // 进入空闲的时间在链表锁内记录
+            return;
+        }
+        // 先写开始时间再发布阶段，定时器不会把新阶段和上一阶段的开始时间配在一起
+        _phase_start_ms.store(CachedClock::MonoMs(), std::memory_order_relaxed);
+        _phase.store(phase, std::memory_order_release);
+    }
+}
+
+void HttpConn::LinkIdle() {
+    std::lock_guard<std::mutex> locker(_idle_mtx);
+    // 在锁内取时间并挂到表尾，多个工作线程同时进入空闲时，链表顺序与进入空闲的时间一致，表头总是最老的
+    _phase_start_ms.store(CachedClock::MonoMs(), std::memory_order_relaxed);
+    _phase.store(IDLE, std::memory_order_release);
+    if (_idle_linked) return;
+    _idle_prev = _idle_tail;
+    _idle_next = nullptr;
+    if (_idle_tail) {
+        _idle_tail->_idle_next = this;
     }
+    else {
+        _idle_head = this;
+    }
+    _idle_tail = this;
+    _idle_linked = true;
+    _idle_count++;
+}
+
+void HttpConn::UnlinkIdle() {
+    std::lock_guard<std::mutex> locker(_idle_mtx);
+    UnlinkIdleLocked();
+}
+
+void HttpConn::UnlinkIdleLocked() {
+    if (!_idle_linked) return;
+    if (_idle_prev) _idle_prev->_idle_next = _idle_next;
+    else _idle_head = _idle_next;
+    if (_idle_next) _idle_next->_idle_prev = _idle_prev;
+    else _idle_tail = _idle_prev;
+    _idle_prev = _idle_next = nullptr;
+    _idle_linked = false;
+    _idle_count--;
+}
+
+HttpConn* HttpConn::PopIdle(int64_t idleBeforeMs) {
+    std::lock_guard<std::mutex> locker(_idle_mtx);
+    HttpConn* conn = _idle_head;
+    if (conn == nullptr || conn->_phase_start_ms.load(std::memory_order_relaxed) > idleBeforeMs) {
+        return nullptr;
+    }
+    conn->UnlinkIdleLocked();
+    return conn;
+}
+
+size_t HttpConn::IdleCount() {
+    std::lock_guard<std::mutex> locker(_idle_mtx);
+    return _idle_count;
 }
 
 int HttpConn::GetFd() const {
-    return _fd;
+    return _hot ? _hot->fd : -1;
 };
 
 struct sockaddr_in HttpConn::GetAddr() const {
@@ -45,17 +172,25 @@ struct sockaddr_in HttpConn::GetAddr() const {
 }
 
 const char* HttpConn::GetIP() const {
+    // Unix 域套接字上的连接没有对端 IP
+    if (IsUnix()) return "unix";
     return inet_ntoa(_addr.sin_addr);
 }
 
 int HttpConn::GetPort() const {
-    return _addr.sin_port;
+    return IsUnix() ? 0 : ntohs(_addr.sin_port);
 }
 
 ssize_t HttpConn::read(int* saveErrno) {
     ssize_t len = -1;
+    if (_request_start_ms == 0) {
+        _request_start_ms = CachedClock::MonoMs();  // 新请求的第一个读事件
+    }
+    if (_phase.load(std::memory_order_relaxed) == IDLE) {
+        EnterPhase(READ_HEADER);  // 空闲连接来了新请求
+    }
     do {
-        len = read_buff.ReadFd(_fd, saveErrno);
+        len = read_buff.ReadFd(_hot->fd, saveErrno);
         if (len <= 0) {
             break;
         }
@@ -66,66 +201,222 @@ ssize_t HttpConn::read(int* saveErrno) {
 ssize_t HttpConn::write(int* saveErrno) {
     ssize_t len = -1;
     do {
-        len = writev(_fd, _iov, _iov_cnt);
-        // 在每次迭代中打印 _iov 中的数据内容
-        //printf("Sent data: %.*s\n", static_cast<int>(len), static_cast<char*>(_iov[0].iov_base));
+        // 响应头在写缓冲区的块链表里，文件内容是 mmap 的内存，一次 writev 一起写出
+        len = write_buff.WriteFd(_hot->fd, saveErrno, &_hot->file_iov);
         if(len <= 0) {
-            *saveErrno = errno;
             break;
         }
-        if(_iov[0].iov_len + _iov[1].iov_len  == 0) { break; } // 传输结束
-        else if(static_cast<size_t>(len) > _iov[0].iov_len) {
-            _iov[1].iov_base = (uint8_t*) _iov[1].iov_base + (len - _iov[0].iov_len);
-            _iov[1].iov_len -= (len - _iov[0].iov_len);
-            if(_iov[0].iov_len) {
-                write_buff.RetrieveAll();
-                _iov[0].iov_len = 0;
-            }
-        }
-        else {
-            _iov[0].iov_base = (uint8_t*)_iov[0].iov_base + len; 
-            _iov[0].iov_len -= len; 
-            write_buff.Retrieve(len);
+        TouchPhase();  // 有写出进展，写超时重新计时
+        if(ToWriteBytes() == 0) { break; } // 传输结束
+        if(!_corked && !IsUnix() && SocketTuning::Instance()->Cork()) {
+            // 一次写不完的大响应：塞住套接字，发送缓冲区陆续腾出的零碎空间不单独发小包，写完再拔塞
+            SocketTuning::SetCork(_hot->fd, true);
+            _corked = true;
         }
     } while(_is_ET || ToWriteBytes() > 10240);
+    if(_corked && ToWriteBytes() == 0) {
+        SocketTuning::SetCork(_hot->fd, false);
+        _corked = false;
+    }
     return len;
 }
 
-bool HttpConn::process() {
+void HttpConn::LogAccess() {
+    AccessLog* accessLog = AccessLog::Instance();
+    if (accessLog->IsOpen()) {
+        int64_t latency = _request_start_ms > 0 ? CachedClock::MonoMs() - _request_start_ms : 0;
+        // 经本机反向代理（Unix 域套接字或回环地址）转发的请求，记录代理转发来的客户端地址
+        char ip[INET6_ADDRSTRLEN];
+        std::string_view forwarded;
+        if (IsUnix() || (ntohl(_addr.sin_addr.s_addr) >> 24) == 127) {
+            forwarded = _request.ForwardedFor();
+        }
+        if (!forwarded.empty() && forwarded.size() < sizeof(ip)) {
+            memcpy(ip, forwarded.data(), forwarded.size());
+            ip[forwarded.size()] = '\0';
+        }
+        else {
+            snprintf(ip, sizeof(ip), "%s", GetIP());
+        }
+        accessLog->Append(ip, _request.method(), _request.path(), _response.Code(), _response_bytes, latency);
+    }
+    _request_start_ms = 0;
+}
+
+void HttpConn::ReleaseMemory() {
+    read_buff.Release();
+    write_buff.Release();
+    _hot->file_iov = { nullptr, 0 };
     _request.Init();
-    if(read_buff.ReadableBytes() <= 0) {
+    _arena.Release();
+    _response.UnmapFile();
+}
+
+size_t HttpConn::MemoryBytes() const {
+    return sizeof(HttpConnHot) + sizeof(HttpConn) + (read_buff.ChunkCount() + write_buff.ChunkCount()) * sizeof(BufferChunk)
+        + _arena.MemoryBytes();
+}
+
+bool HttpConn::PeekRequestLine(char* head, size_t size, std::string_view* method, std::string_view* path) const {
+    // 只看请求行开头，复制到栈上解析（可能跨块）
+    size_t len = read_buff.Find("\r", 1, size);
+    bool complete = len != Buffer::npos;
+    if (!complete) {
+        len = std::min(read_buff.ReadableBytes(), size);
+    }
+    read_buff.PeekCopy(head, len);
+    std::string_view line(head, len);
+    size_t pathBegin = line.find(' ');
+    if (pathBegin == std::string_view::npos) {
+        return false;
+    }
+    *method = line.substr(0, pathBegin);
+    pathBegin++;
+    size_t pathEnd = line.find_first_of(" ?", pathBegin);
+    if (pathEnd == std::string_view::npos) {
+        *path = line.substr(pathBegin);
+        return false;  // 请求行不完整，路径可能被截断
+    }
+    *path = line.substr(pathBegin, pathEnd - pathBegin);
+    return complete;
+}
+
+bool HttpConn::IsDbRequest() const {
+    char head[256];  // 路由路径很短
+    std::string_view method, path;
+    PeekRequestLine(head, sizeof(head), &method, &path);
+    return HttpResponse::IsRoute(path);
+}
+
+bool HttpConn::IsCachedStatic(size_t maxBytes) const {
+    char head[512];
+    std::string_view method, path;
+    if (!PeekRequestLine(head, sizeof(head), &method, &path) || method != "GET" || path.empty()
+        || path.find('%') != std::string_view::npos) {
+        return false;  // 请求行不完整、不是 GET 或路径需要解码，交给线程池
+    }
+    if (path == "/") {
+        path = "/index.html";
+    }
+    char file[PATH_MAX];
+    int n = snprintf(file, sizeof(file), "%s%.*s", _src_dir, static_cast<int>(path.size()), path.data());
+    if (n <= 0 || static_cast<size_t>(n) >= sizeof(file)) {
+        return false;
+    }
+    // 有效期内直接用上次的判定，命中时没有系统调用（每次探测的 munmap 都要让所有工作线程所在的核刷新 TLB）
+    std::string_view name(file, n);
+    size_t key = std::hash<std::string_view>()(name);
+    int64_t now = CachedClock::MonoMs();
+    auto it = _static_probes.find(key);
+    if (it != _static_probes.end() && it->second.file == name && now - it->second.checked_ms < STATIC_RECHECK_MS) {
+        return it->second.resident && it->second.size <= maxBytes;
+    }
+    struct stat st;
+    if (stat(file, &st) < 0 || !S_ISREG(st.st_mode) || !(st.st_mode & S_IROTH) || st.st_size <= 0) {
+        if (it != _static_probes.end()) {
+            _static_probes.erase(it);
+        }
+        return false;  // 不存在、没有权限（错误页）交给线程池
+    }
+    size_t size = st.st_size;
+    bool resident = size <= maxBytes && IsResident(file, size);  // 大文件不探测，有效期内同样直接交给线程池
+    if (it == _static_probes.end()) {
+        if (_static_probes.size() >= STATIC_PROBE_MAX) {
+            _static_probes.clear();
+        }
+        it = _static_probes.emplace(key, StaticProbe()).first;
+    }
+    it->second.file.assign(name.data(), name.size());
+    it->second.size = size;
+    it->second.checked_ms = now;
+    it->second.resident = resident;
+    return resident;
+}
+
+bool HttpConn::IsResident(const char* file, size_t size) {
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         return false;
     }
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    const size_t pages = (size + pageSize - 1) / pageSize;
+    unsigned char vec[256];
+    bool resident = pages <= sizeof(vec) && mincore(addr, size, vec) == 0;
+    for (size_t i = 0; resident && i < pages; i++) {
+        resident = vec[i] & 1;
+    }
+    munmap(addr, size);
+    return resident;
+}
+
+bool HttpConn::process() {
+    if (_request.State() != HttpRequest::BODY) {
+        // 上一个请求的内容先放弃，再整体回收请求级内存（请求头已解析、还在等请求体时保留）
+        _request.Init();
+        _arena.Reset();
+        if(read_buff.ReadableBytes() <= 0) {
+            // 没有待处理的请求，连接进入空闲，内存先还回去，下一个请求到来时再取
+            EnterPhase(IDLE);
+            ReleaseMemory();
+            return false;
+        }
+    }
     // 解析http请求
-    else if(_request.parse(read_buff)) {
+    HttpRequest::HTTP_CODE ret = _request.parse(read_buff);
+    if (ret == HttpRequest::NO_REQUEST) {
+        // 请求不完整，继续读；阶段不变时超时期限不延长
+        EnterPhase(_request.State() == HttpRequest::BODY ? READ_BODY : READ_HEADER);
+        return false;
+    }
+    else if (ret == HttpRequest::TOO_LARGE_REQUEST) {
+        EnterPhase(ABORT);
+        return false;
+    }
+    else if(ret == HttpRequest::GET_REQUEST) {
         LOG_DEBUG("%s", _request.path().c_str());
-        auto _post = _request.GetPost();
-        _response.Init(_src_dir, _request.path(), _request.IsKeepAlive(), 200, _post);
+        if (_request_start_ms == 0) {
+            _request_start_ms = CachedClock::MonoMs();  // 同一次读到的后续请求
+        }
+        if (ThreadPool::Shedding() || !Admission::Instance()->AcquireRequest(_addr.sin_addr.s_addr)) {
+            // 在线程池里排队过久（过载卸载）或该 IP 请求速率超限：回复预先生成的 503 后关闭连接
+            _response.Init(_src_dir, _request.path(), false, 503);
+            write_buff.Append(Admission::Instance()->Response503());
+            _hot->file_iov = { nullptr, 0 };
+            _response_bytes = ToWriteBytes();
+            EnterPhase(WRITE);
+            return true;
+        }
+        // 请求数达到上限后本次响应关闭连接
+        _request_count++;
+        bool keepAlive = _request.IsKeepAlive() && (_keep_alive_max <= 0 || _request_count < _keep_alive_max);
+        // 响应直接引用请求的参数表，不再复制
+        _response.Init(_src_dir, _request.path(), keepAlive, 200, &_request.GetPost());
+        if (keepAlive && _keep_alive_max > 0) {
+            _response.SetKeepAliveLeft(_keep_alive_max - _request_count);
+        }
 
     } else {
-        auto _post = _request.GetPost();
-        _response.Init(_src_dir, _request.path(), false, 400, _post);
+        _response.Init(_src_dir, _request.path(), false, 400, &_request.GetPost());
         return false;
     }
+    EnterPhase(WRITE);
     
     // 制作响应
     _response.MakeResponse(write_buff);
-    // 响应头
-    _iov[0].iov_base = const_cast<char*>(write_buff.Peek());
-    _iov[0].iov_len = write_buff.ReadableBytes();
-    _iov_cnt = 1;
-    
-    //std::string res(write_buff.Peek(), write_buff.BeginWriteConst());
-    //LOG_DEBUG("响应: %s", res.c_str());
-    
-    
-    // 文件
+    // 响应头已在写缓冲区中，文件单独作为最后一段
+    _hot->file_iov.iov_base = nullptr;
+    _hot->file_iov.iov_len = 0;
     if(_response.FileLen() > 0  && _response.File()) {
-        _iov[1].iov_base = _response.File();
-        _iov[1].iov_len = _response.FileLen();
-        _iov_cnt = 2;
+        _hot->file_iov.iov_base = _response.File();
+        _hot->file_iov.iov_len = _response.FileLen();
     }
     
-    LOG_DEBUG("filesize:%d, %d  to %d", _response.FileLen() , _iov_cnt, ToWriteBytes());
+    _response_bytes = ToWriteBytes();
+    LOG_DEBUG("filesize:%d, %d chunks to %d", _response.FileLen() , (int)write_buff.ChunkCount(), ToWriteBytes());
     return true;
   }
@@ -1,6 +1,8 @@
 #include "../include/httprequest.h"
 #include "../include/util.h"
 
+#include <sstream>
+
 using namespace std;
 
 
@@ -11,11 +13,26 @@ const unordered_set<string> HttpRequest::_default_html{
 const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG {
             {"/register.html", 0}, {"/login.html", 1},  };
 
+size_t HttpRequest::_max_header_bytes = 8192;
+size_t HttpRequest::_max_headers = 64;
+
+HttpRequest::HttpRequest(std::pmr::memory_resource* arena)
+    : _arena(arena), _method(arena), _path(arena), _version(arena), _body(arena), _line(arena),
+    _header(PmrMap::allocator_type(arena)), _post(PmrMap::allocator_type(arena)) {
+    Init();
+}
+
 void HttpRequest::Init() {
-    _method = _path = _version = _body = "";
+    // 与空对象交换放弃已占用的内存（clear 会保留容量，arena 回收后就成了悬空指针）
+    PmrString(_arena).swap(_method);
+    PmrString(_arena).swap(_path);
+    PmrString(_arena).swap(_version);
+    PmrString(_arena).swap(_body);
+    PmrString(_arena).swap(_line);
     _state = REQUEST_LINE;
-    _header.clear();
-    _post.clear();
+    _header_lines = 0;
+    PmrMap(PmrMap::allocator_type(_arena)).swap(_header);
+    PmrMap(PmrMap::allocator_type(_arena)).swap(_post);
 }
 
 bool HttpRequest::IsKeepAlive() const {
@@ -25,27 +42,66 @@ bool HttpRequest::IsKeepAlive() const {
     return false;
 }
 
-bool HttpRequest::parse(Buffer& buff) {
+std::string_view HttpRequest::ForwardedFor() const {
+    auto it = _header.find("X-Forwarded-For");
+    if (it == _header.end()) {
+        it = _header.find("x-forwarded-for");
+        if (it == _header.end()) return {};
+    }
+    // 左边的地址由客户端自己填写，只有最右边的是代理添加的
+    std::string_view value(it->second.data(), it->second.size());
+    size_t comma = value.rfind(',');
+    if (comma != std::string_view::npos) {
+        value.remove_prefix(comma + 1);
+    }
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    return value;
+}
+
+HttpRequest::HTTP_CODE HttpRequest::parse(Buffer& buff) {
     const char CRLF[] = "\r\n";
     if (buff.ReadableBytes() <= 0) {
-        return false;  // 缓冲区为空，无法解析
+        return NO_REQUEST;  // 缓冲区为空，无法解析
+    }
+    if (_state == REQUEST_LINE && buff.Find("\r\n\r\n", 4, _max_header_bytes) == Buffer::npos) {
+        // 请求头还没收齐：超过上限直接拒绝，否则等待更多数据（缓冲区内容不动）
+        if (buff.ReadableBytes() >= _max_header_bytes) {
+            LOG_WARN("请求头超过 %zu 字节", _max_header_bytes);
+            return TOO_LARGE_REQUEST;
+        }
+        return NO_REQUEST;
     }
     while (buff.ReadableBytes() && _state != FINISH) {
-        // 在缓冲区中查找换行符（CRLF，即"\r\n"）的位置，从而确定一行内容的结束位置
-        const char* lineEnd = search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        std::string line(buff.Peek(), lineEnd);  // 从缓冲区中读取一行内容
-        LOG_DEBUG("解析: %s", line.c_str());
+        if (_state == BODY && buff.ReadableBytes() < ContentLenth()) {
+            break;  // 请求体还没收齐
+        }
+        // 在缓冲区中查找换行符（CRLF，即"\r\n"）的位置，从而确定一行内容的结束位置（可能跨块）
+        size_t lineLen = buff.Find(CRLF, 2);
+        const bool hasCRLF = lineLen != Buffer::npos;
+        if (!hasCRLF) {
+            lineLen = buff.ReadableBytes();
+        }
+        _line.resize(lineLen);
+        buff.PeekCopy(&_line[0], lineLen);  // 从缓冲区中读取一行内容
+        std::string_view line(_line);
+        LOG_DEBUG("解析: %s", _line.c_str());
         switch (_state) {
         case REQUEST_LINE:
             if (!ParseRequestLine(line)) {
-                return false;   // 解析请求行失败，返回 false
+                return BAD_REQUEST;   // 解析请求行失败
             }
             ParsePath();        // 解析请求路径
             break;
         case HEADERS:
             ParseHeader(line);  // 解析请求头部
-            if (buff.ReadableBytes() <= 2) {
-                _state = FINISH;  // 头部解析完毕，进入 FINISH 状态
+            // 按行数限制：重名的请求头在表中互相覆盖，按表的大小数不出来
+            if (_state == HEADERS && ++_header_lines > _max_headers) {
+                LOG_WARN("请求头超过 %zu 个", _max_headers);
+                return TOO_LARGE_REQUEST;
+            }
+            if (buff.ReadableBytes() <= 2 && !(_state == BODY && ContentLenth() > 0)) {
+                _state = FINISH;  // 头部解析完毕（没有请求体要等），进入 FINISH 状态
             }
             break;
         case BODY:
@@ -54,14 +110,17 @@ bool HttpRequest::parse(Buffer& buff) {
         default:
             break;
         }
-        if (lineEnd == buff.BeginWrite()) {
+        if (!hasCRLF) {
             break;  // 已处理完缓冲区中的所有内容，退出循环
         }
-        buff.RetrieveUntil(lineEnd + 2);  // 从缓冲区中移除已解析的内容
+        buff.Retrieve(lineLen + 2);  // 从缓冲区中移除已解析的内容
+    }
+    if (_state == BODY && buff.ReadableBytes() < ContentLenth()) {
+        return NO_REQUEST;  // 请求头已解析，继续等待请求体
     }
     // 在调试日志中打印解析得到的请求方法、路径和版本
     LOG_DEBUG("[%s], [%s], [%s]", _method.c_str(), _path.c_str(), _version.c_str());
-    return true;
+    return GET_REQUEST;
 }
 
 void HttpRequest::ParsePath() {
@@ -71,28 +130,28 @@ void HttpRequest::ParsePath() {
     }
     // url jiema
     else if(_method == "GET") {
-      _path = Util::UrlDecode(_path);
+      _path.resize(Util::UrlDecode(&_path[0], _path.size()));
     }
 }
 
-bool HttpRequest::ParseRequestLine(const string& line) {
-    // 定义正则表达式模式，匹配请求行的格式
-    regex pattern("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-
-    // 存储匹配结果的对象
-    smatch subMatch;
-    // 使用正则表达式匹配请求行内容
-    if (regex_match(line, subMatch, pattern)) {
-        // 获取匹配到的子串，分别表示请求方法、请求路径、HTTP版本
-        _method = subMatch[1];
-        _path = subMatch[2];
-        _version = subMatch[3];
-
-        // 将状态设置为解析头部信息
-        _state = HEADERS;
-
-        // 解析成功，返回 true
-        return true;
+bool HttpRequest::ParseRequestLine(string_view line) {
+    // 请求行格式：方法 路径 HTTP/版本，三段之间各一个空格，各段内不含空格
+    size_t methodEnd = line.find(' ');
+    size_t pathEnd = methodEnd == string_view::npos ? string_view::npos : line.find(' ', methodEnd + 1);
+    if (pathEnd != string_view::npos) {
+        string_view version = line.substr(pathEnd + 1);
+        if (version.substr(0, 5) == "HTTP/" && version.find(' ') == string_view::npos) {
+            // 获取请求方法、请求路径、HTTP版本
+            _method.assign(line.data(), methodEnd);
+            _path.assign(line.data() + methodEnd + 1, pathEnd - methodEnd - 1);
+            _version.assign(version.data() + 5, version.size() - 5);
+
+            // 将状态设置为解析头部信息
+            _state = HEADERS;
+
+            // 解析成功，返回 true
+            return true;
+        }
     }
 
     // 若匹配失败，输出错误日志并返回 false
@@ -101,15 +160,16 @@ bool HttpRequest::ParseRequestLine(const string& line) {
 }
 
 
-void HttpRequest::ParseHeader(const string& line) {
-    // 定义正则表达式模式，用于匹配 HTTP 请求头部行的格式
-    regex patten("^([^:]*): ?(.*)$");
-    smatch subMatch;
-
-    if (regex_match(line, subMatch, patten)) {
-        // 如果匹配成功，将匹配到的内容添加到请求头部的映射中
-        // 匹配到的 subMatch[1] 是请求头部字段，subMatch[2] 是字段值
-        _header[subMatch[1]] = subMatch[2];
+void HttpRequest::ParseHeader(string_view line) {
+    // 请求头部行格式：字段: 值（冒号后最多跳过一个空格）
+    size_t colon = line.find(':');
+    if (colon != string_view::npos) {
+        // 将字段和值添加到请求头部的映射中，字段重复时后者覆盖前者
+        string_view value = line.substr(colon + 1);
+        if (!value.empty() && value[0] == ' ') {
+            value.remove_prefix(1);
+        }
+        _header[PmrString(line.data(), colon, _arena)].assign(value.data(), value.size());
     }
     else {
         // 如果当前行不符合请求头部行格式，说明已经解析完请求头部，进入请求体解析状态, 即匹配到空行了
@@ -119,12 +179,12 @@ void HttpRequest::ParseHeader(const string& line) {
 
 
 
-void HttpRequest::ParseBody(const string& line) {
+void HttpRequest::ParseBody(string_view line) {
     if(_method == "GET") return;
-    _body = line;                                               // 将请求体内容存储在 _body 变量中
+    _body.assign(line.data(), line.size());                     // 将请求体内容存储在 _body 变量中
     ParsePost();                                                // 解析请求体中的表单数据
     _state = FINISH;                                            // 将请求状态设置为 FINISH，表示解析完成
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());    // 输出日志，记录解析后的请求体内容和长度
+    LOG_DEBUG("Body:%s, len:%d", _body.c_str(), _body.size());  // 输出日志，记录解析后的请求体内容和长度
 }
 
 
@@ -158,13 +218,14 @@ void HttpRequest::ParseJson() {
   // 解析 JSON 请求体数据
   Json::CharReaderBuilder readerBuilder;
   Json::Value jsonData;
-  std::istringstream iss(_body);
+  std::istringstream iss(std::string(_body.data(), _body.size()));
   std::string errs;
   if (Json::parseFromStream(readerBuilder, iss, &jsonData, &errs)) {
     for (const auto& key : jsonData.getMemberNames()) {
       if(jsonData[key].isString()) {
-        _post[key] = jsonData[key].asString();
-        LOG_DEBUG("JSON解析:%s : %s", key.c_str(), _post[key].c_str());
+        const std::string value = jsonData[key].asString();
+        _post[PmrString(key.data(), key.size(), _arena)].assign(value.data(), value.size());
+        LOG_DEBUG("JSON解析:%s : %s", key.c_str(), value.c_str());
       }
     }
   } else {
@@ -179,7 +240,7 @@ void HttpRequest::ParseFromUrlencoded() {
         return;
     }
 
-    string key, value;
+    PmrString key(_arena), value(_arena);
     int num = 0;
     int n = _body.size();
     int i = 0, j = 0;
@@ -189,7 +250,7 @@ void HttpRequest::ParseFromUrlencoded() {
         switch (ch) {
         case '=':
             // 解析表单数据的键
-            key = _body.substr(j, i - j);
+            key.assign(_body, j, i - j);
             j = i + 1;
             break;
         case '+':
@@ -204,7 +265,7 @@ void HttpRequest::ParseFromUrlencoded() {
             break;
         case '&':
             // 解析表单数据的值
-            value = _body.substr(j, i - j);
+            value.assign(_body, j, i - j);
             j = i + 1;
             _post[key] = value; // 将键值对添加到 _post 中
             LOG_DEBUG("%s = %s", key.c_str(), value.c_str()); // 输出日志
@@ -217,7 +278,7 @@ void HttpRequest::ParseFromUrlencoded() {
     assert(j <= i);
     // 检查是否有未处理的键值对
     if (_post.count(key) == 0 && j < i) {
-        value = _body.substr(j, i - j);
+        value.assign(_body, j, i - j);
         _post[key] = value;
     }
 }
@@ -226,27 +287,27 @@ void HttpRequest::ParseFromData() {
 
 }
 
-std::string HttpRequest::path() const{
+const HttpRequest::PmrString& HttpRequest::path() const{
     return _path;
 }
 
-std::string& HttpRequest::path(){
+HttpRequest::PmrString& HttpRequest::path(){
     return _path;
 }
-std::string HttpRequest::method() const {
+const HttpRequest::PmrString& HttpRequest::method() const {
     return _method;
 }
 
-std::string HttpRequest::version() const {
+const HttpRequest::PmrString& HttpRequest::version() const {
     return _version;
 }
 
-const std::unordered_map<std::string, std::string>& HttpRequest::Handler() {
+const HttpRequest::PmrMap& HttpRequest::Handler() {
   return _header;
 }
 
 size_t HttpRequest::ContentLenth() {
-  if(_method == "POST") return stoi(_header["Content-Length"]);
+  if(_method == "POST") return atoi(_header["Content-Length"].c_str());
   return 0;
 }
 
@@ -256,21 +317,23 @@ size_t HttpRequest::BodyLenth() {
 
 std::string HttpRequest::GetPost(const std::string& key) const {
     assert(key != "");
-    if(_post.count(key) == 1) {
-        return _post.find(key)->second;
+    auto it = _post.find(PmrString(key.data(), key.size()));
+    if(it != _post.end()) {
+        return std::string(it->second);
     }
     return "";
 }
 
 std::string HttpRequest::GetPost(const char* key) const {
     assert(key != nullptr);
-    if(_post.count(key) == 1) {
-        return _post.find(key)->second;
+    auto it = _post.find(key);
+    if(it != _post.end()) {
+        return std::string(it->second);
     }
     return "";
 }
 
-const std::unordered_map<std::string, std::string>& HttpRequest::GetPost()
+const HttpRequest::PmrMap& HttpRequest::GetPost()
 {
     return _post;
 }
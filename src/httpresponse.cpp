@@ -44,25 +44,31 @@ const unordered_map<int, string> HttpResponse::_codePATH = {
     { 404, "/404.html" },
 };
 
+int HttpResponse::_keep_alive_timeout = 60;
+
 HttpResponse::HttpResponse() {
     _code = -1;
     _path = _src_root_dir = "";
     _isKeepAlive = false;
+    _keep_alive_left = 0;
     _mm_file = nullptr; 
     _mm_file_stat = { 0 };
+    _post = nullptr;
 };
 
 HttpResponse::~HttpResponse() {
     UnmapFile();
 }
 
-void HttpResponse::Init(const string& _src_dir, string& path, bool isKeepAlive, int code, const std::unordered_map<std::string, std::string>& post){
-    assert(_src_dir != "");
+void HttpResponse::Init(const char* srcDir, string_view path, bool isKeepAlive, int code, const HttpRequest::PmrMap* post){
+    assert(srcDir && *srcDir);
     if(_mm_file) { UnmapFile(); }
     _code = code;
     _isKeepAlive = isKeepAlive;
-    _path = path;
-    _src_root_dir = _src_dir;
+    _keep_alive_left = 0;
+    // assign 复用已有容量，稳定后不再申请内存
+    _path.assign(path.data(), path.size());
+    _src_root_dir.assign(srcDir);
     _mm_file = nullptr; 
     _mm_file_stat = { 0 };
     _post = post;
@@ -84,7 +90,7 @@ void HttpResponse::MakeResponse(Buffer& buff) {
         _code = 404;
       }
     }
-    else if (stat((_src_root_dir + _path).data(), &_mm_file_stat) < 0) {
+    else if (stat(FilePath(), &_mm_file_stat) < 0) {
         _code = 404;  // 请求的资源不存在，设置状态码为 404
     }
     else if (!(_mm_file_stat.st_mode & S_IROTH)) {
@@ -103,6 +109,20 @@ void HttpResponse::MakeResponse(Buffer& buff) {
 
 
 
+bool HttpResponse::IsRoute(string_view path) {
+    // 路由很少，逐个比较，不用为查找构造 string
+    for (const string& route : _route) {
+        if (route == path) return true;
+    }
+    return false;
+}
+
+const char* HttpResponse::FilePath() {
+    _file_path.assign(_src_root_dir);
+    _file_path.append(_path);
+    return _file_path.c_str();
+}
+
 char* HttpResponse::File() {
     return _mm_file;
 }
@@ -115,32 +135,48 @@ void HttpResponse::ErrorHtml() {
     if(_route.find(_path) != _route.end()) return;
     if(_codePATH.count(_code) == 1) {
         _path = _codePATH.find(_code)->second;
-        stat((_src_root_dir + _path).data(), &_mm_file_stat);
+        stat(FilePath(), &_mm_file_stat);
     }
 }
 
 void HttpResponse::AddStateLine(Buffer& buff) {
-    string status;
-    if(_code_status.count(_code) == 1) {
-        status = _code_status.find(_code)->second;
-    }
-    else {
+    if(_code_status.count(_code) != 1) {
         _code = 400;
-        status = _code_status.find(400)->second;
     }
-    if(_route.find(_path) != _route.end()) buff.Append("HTTP/1.1 " + to_string(_code) + " " + _status + "\r\n");
-    else buff.Append("HTTP/1.1 " + to_string(_code) + " " + _status + "\r\n");
+    char line[32];
+    int len = snprintf(line, sizeof(line), "HTTP/1.1 %d ", _code);
+    buff.Append(line, len);
+    buff.Append(_status);
+    buff.Append("\r\n");
 }
 
 void HttpResponse::AddHeader(Buffer& buff) {
     buff.Append("Connection: ");
     if(_isKeepAlive) {
         buff.Append("keep-alive\r\n");
-        buff.Append("keep-alive: max=6, timeout=120\r\n");
+        // 通告服务器实际执行的空闲超时和剩余请求数
+        char line[64];
+        int len = 0;
+        if (_keep_alive_left > 0 && _keep_alive_timeout > 0) {
+            len = snprintf(line, sizeof(line), "keep-alive: max=%d, timeout=%d\r\n", _keep_alive_left, _keep_alive_timeout);
+        }
+        else if (_keep_alive_left > 0) {
+            len = snprintf(line, sizeof(line), "keep-alive: max=%d\r\n", _keep_alive_left);
+        }
+        else if (_keep_alive_timeout > 0) {
+            len = snprintf(line, sizeof(line), "keep-alive: timeout=%d\r\n", _keep_alive_timeout);
+        }
+        buff.Append(line, len);
     } else{
         buff.Append("close\r\n");
     }
-    buff.Append("Content-type: " + GetFileType_() + "\r\n");
+    buff.Append("Content-type: ");
+    buff.Append(GetFileType_());
+    buff.Append("\r\n");
+    const char* date = CachedClock::HttpDate();  // 按线程缓存，同一秒内不重复格式化
+    buff.Append("Date: ");
+    buff.Append(date, strlen(date));
+    buff.Append("\r\n");
 }
 
 void HttpResponse::AddContent(Buffer& buff) {
@@ -182,14 +218,14 @@ void HttpResponse::AddContent(Buffer& buff) {
       buff.Append(jsonResponse);
       return;
     }
-    int srcFd = open((_src_root_dir + _path).data(), O_RDONLY);
+    int srcFd = open(FilePath(), O_RDONLY);
     if(srcFd < 0) { 
         ErrorContent(buff, "File NotFound!");
         return; 
     }
 
     //将文件映射到内存提高文件的访问速度 MAP_PRIVATE 建立一个写入时拷贝的私有映射
-    LOG_DEBUG("file path %s", (_src_root_dir + _path).data());
+    LOG_DEBUG("file path %s", _file_path.c_str());
     int* mmRet = (int*)mmap(0, _mm_file_stat.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
     if(*mmRet == -1) {
         ErrorContent(buff, "File NotFound!");
@@ -197,7 +233,9 @@ void HttpResponse::AddContent(Buffer& buff) {
     }
     _mm_file = (char*)mmRet;
     close(srcFd);
-    buff.Append("Content-length: " + to_string(_mm_file_stat.st_size) + "\r\n\r\n");
+    char header[64];
+    int len = snprintf(header, sizeof(header), "Content-length: %lld\r\n\r\n", static_cast<long long>(_mm_file_stat.st_size));
+    buff.Append(header, len);
 }
 
 void HttpResponse::UnmapFile() {
@@ -207,22 +245,23 @@ void HttpResponse::UnmapFile() {
     }
 }
 
-string HttpResponse::GetFileType_() {
-    
+const string& HttpResponse::GetFileType_() {
+    static const string plain = "text/plain";
     if(_route.find(_path) != _route.end()) {
       if((_path == "/register" || _path == "/login") && _suffix_type.count(".json") == 1) return _suffix_type.find(".json")->second;
-      return "text/plain";
+      return plain;
     }
     /* 判断文件类型 */
     string::size_type idx = _path.find_last_of('.');
-    if(idx == string::npos) {
-        return "text/plain";
+    // 已知后缀都很短，过长的后缀直接按纯文本处理，查表用的临时串不会申请堆内存
+    if(idx == string::npos || _path.size() - idx > 15) {
+        return plain;
     }
-    string suffix = _path.substr(idx);
-    if(_suffix_type.count(suffix) == 1) {
-        return _suffix_type.find(suffix)->second;
+    auto it = _suffix_type.find(_path.substr(idx));
+    if(it != _suffix_type.end()) {
+        return it->second;
     }
-    return "text/plain";
+    return plain;
 }
 
 void HttpResponse::ErrorContent(Buffer& buff, string message) 
@@ -246,7 +285,7 @@ void HttpResponse::ErrorContent(Buffer& buff, string message)
 
 void HttpResponse::HandlerRegister()
 {
-    if (_post.empty()) {
+    if (_post == nullptr || _post->empty()) {
         _code = 400;
         _status = "Bad Request";
         LOG_DEBUG("处理登录请求，body为空");
@@ -254,16 +293,16 @@ void HttpResponse::HandlerRegister()
     }
 
     // 检查是否存在所需字段
-    if (_post.find("name") == _post.end() || _post.find("password") == _post.end() || _post.find("phone") == _post.end()) {
+    if (_post->find("name") == _post->end() || _post->find("password") == _post->end() || _post->find("phone") == _post->end()) {
         _code = 400;
         _status = "Bad Request";
         LOG_DEBUG("处理登录请求，缺少所需字段");
         return;
     }
 
-    const std::string name = _post.find("name")->second;
-    const std::string phone = _post.find("phone")->second;
-    const std::string password = _post.find("password")->second;
+    const std::string name(_post->find("name")->second);
+    const std::string phone(_post->find("phone")->second);
+    const std::string password(_post->find("password")->second);
 
     int res = MysqlOpt::Register(name, phone, password);
     if (res == 0) {
@@ -285,7 +324,7 @@ void HttpResponse::HandlerRegister()
 
 void HttpResponse::HandlerLogin()
 {
-    if (_post.empty()) {
+    if (_post == nullptr || _post->empty()) {
         _code = 400;
         _status = "Bad Request";
         LOG_DEBUG("body为空");
@@ -293,14 +332,14 @@ void HttpResponse::HandlerLogin()
     }
 
     // 检查是否存在所需字段
-    if (_post.find("name") == _post.end() || _post.find("password") == _post.end()) {
+    if (_post->find("name") == _post->end() || _post->find("password") == _post->end()) {
         _code = 400;
         _status = "Bad Request";
         LOG_DEBUG("缺少所需字段");
         return;
     }
-    const std::string name = _post.find("name")->second;
-    const std::string password = _post.find("password")->second;
+    const std::string name(_post->find("name")->second);
+    const std::string password(_post->find("password")->second);
 
     int res = MysqlOpt::Login(name, password);
     if (res == 0) {
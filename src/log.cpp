@@ -1,73 +1,143 @@
-#include "../include/log.h" 
+#include "../include/log.h"
+#include "../include/affinity.h"
+#include "../include/cachedclock.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sched.h>
 
 using namespace std;
 
+LogRing::LogRing(size_t capacity) {
+    _capacity = 1;
+    while (_capacity < capacity) _capacity <<= 1;
+    _mask = _capacity - 1;
+    _buf = new char[_capacity];
+    _detached = false;
+    _write_pos = 0;
+    _read_pos = 0;
+}
+
+LogRing::~LogRing() {
+    delete[] _buf;
+}
+
+bool LogRing::TryPush(const char* data, size_t len) {
+    size_t w = _write_pos.load(std::memory_order_relaxed);
+    size_t r = _read_pos.load(std::memory_order_acquire);
+    if (_capacity - (w - r) < len) return false;
+    size_t off = w & _mask;
+    size_t first = min(len, _capacity - off);
+    memcpy(_buf + off, data, first);
+    memcpy(_buf, data + first, len - first);
+    _write_pos.store(w + len, std::memory_order_release);
+    return true;
+}
+
+size_t LogRing::Peek(struct iovec iov[2]) const {
+    size_t r = _read_pos.load(std::memory_order_relaxed);
+    size_t w = _write_pos.load(std::memory_order_acquire);
+    size_t n = w - r;
+    size_t off = r & _mask;
+    size_t first = min(n, _capacity - off);
+    iov[0].iov_base = _buf + off;
+    iov[0].iov_len = first;
+    iov[1].iov_base = _buf;
+    iov[1].iov_len = n - first;
+    return n;
+}
+
+void LogRing::Consume(size_t n) {
+    _read_pos.store(_read_pos.load(std::memory_order_relaxed) + n, std::memory_order_release);
+}
+
+size_t LogRing::Used() const {
+    return _write_pos.load(std::memory_order_acquire) - _read_pos.load(std::memory_order_acquire);
+}
+
+namespace {
+
+// 线程退出时标记环形缓冲区，刷盘线程读空后回收
+struct RingHolder {
+    shared_ptr<LogRing> ring;
+    ~RingHolder() {
+        if (ring) ring->Detach();
+    }
+};
+
+thread_local RingHolder t_ring;
+thread_local char t_line[Log::LOG_LINE_MAX];        // 每个线程格式化一行的临时缓冲
+
+}
+
 Log::Log() {
     _line_count = 0;
     _is_async = false;
+    _is_open = false;
+    _level = 1;
+    _site_rate = 0;
     _write_thread = nullptr;
-    _deque = nullptr;
     _to_day = 0;
-    _log_file_fp = nullptr;
+    _file_index = 0;
+    _log_fd = -1;
+    _ring_size = 256 * 1024;
+    _overflow = OVERFLOW_BLOCK;
+    _flush_interval_ms = 50;
+    _dropped = 0;
+    _dropped_total = 0;
+    _wake_pending = false;
+    _space_waiters = 0;
+    _stop = false;
+    _is_binary = false;
+    _format_sec = -1;
+    _format_prefix[0] = '\0';
+    _bad_records = 0;
+    _bad_total = 0;
 }
 
 Log::~Log() {
-    // 释放资源和线程
+    // 停止刷盘线程，线程退出前会把所有缓冲区写完
     if (_write_thread && _write_thread->joinable()) {
-        while (!_deque->empty()) {
-            _deque->flush();
-        };
-        _deque->Close();
+        {
+            lock_guard<mutex> locker(_flush_mtx);
+            _stop = true;
+        }
+        _flush_cond.notify_one();
         _write_thread->join();
     }
-    if (_log_file_fp) {
+    if (_log_fd >= 0) {
         lock_guard<mutex> locker(_mtx);
-        flush();
-        fclose(_log_file_fp);
+        close(_log_fd);
+        _log_fd = -1;
     }
 }
 
 int Log::GetLevel() {
-    // 获取日志级别
-    lock_guard<mutex> locker(_mtx);
-    return _level;
+    // 获取日志级别，每条日志都会调用，不加锁
+    return _level.load(std::memory_order_relaxed);
 }
 
 void Log::SetLevel(int level) {
     // 设置日志级别
-    lock_guard<mutex> locker(_mtx);
-    _level = level;
+    _level.store(level, std::memory_order_relaxed);
 }
 
 void Log::init(int level, const char* path, const char* suffix,
-    int maxQueueSize, int log_max_size) {
+    int maxQueueSize, int log_max_size, int ringSizeKb, OverflowPolicy overflow, int flushIntervalMs, bool binary) {
     _log_max_lines = log_max_size;
     // 初始化日志
-    _is_open = true; // 标记日志系统为开启状态
     _level = level; // 设置日志级别
-
-    if (maxQueueSize > 0) {
-        _is_async = true; // 启用异步写入模式
-
-        if (!_deque) {
-            // 如果异步队列为空，创建一个新的异步队列
-            unique_ptr<BlockDeque<std::string>> newDeque(new BlockDeque<std::string>);
-            _deque = move(newDeque);
-
-            // 启动异步线程去刷新缓冲区数据到文件
-            std::unique_ptr<std::thread> NewThread(new thread(FlushLogThread));
-            _write_thread = move(NewThread);
-        }
-    }
-    else {
-        _is_async = false; // 关闭异步写入模式
-    }
+    _ring_size = static_cast<size_t>(ringSizeKb > 0 ? ringSizeKb : 256) * 1024;  // 不小于 1KB，总能放下一整行
+    _overflow = overflow;
+    _flush_interval_ms = flushIntervalMs > 0 ? flushIntervalMs : 50;
 
     _line_count = 0; // 初始化行计数器
+    _file_index = 0;
 
     time_t timer = time(nullptr); // 获取当前时间戳
-    struct tm* sysTime = localtime(&timer); // 转换为本地时间结构
-    struct tm t = *sysTime;
+    struct tm t;
+    localtime_r(&timer, &t); // 转换为本地时间结构
 
     _path = path;
     _suffix = suffix;
@@ -75,137 +145,487 @@ void Log::init(int level, const char* path, const char* suffix,
     char fileName[LOG_NAME_LEN] = { 0 };
     // 使用格式化字符串生成日志文件名
     snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s",
-        _path, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, _suffix);
-    _to_day = t.tm_mday; 
+        _path.c_str(), t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, _suffix.c_str());
+    _to_day = t.tm_mday;
 
     {
         lock_guard<mutex> locker(_mtx);
-        _buff.RetrieveAll(); // 清空缓冲区
-        if (_log_file_fp) {
-            flush(); // 刷新缓冲区到文件
-            fclose(_log_file_fp); // 关闭之前的日志文件
+        if (_log_fd >= 0) {
+            close(_log_fd); // 关闭之前的日志文件
         }
 
         // 创建新的日志文件并以追加模式打开
-        _log_file_fp = fopen(fileName, "a");
-        if (_log_file_fp == nullptr) {
-            mkdir(_path, 0777); // 如果目录不存在，创建目录
-            _log_file_fp = fopen(fileName, "a"); // 再次尝试打开文件
+        _log_fd = open(fileName, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (_log_fd < 0) {
+            mkdir(_path.c_str(), 0777); // 如果目录不存在，创建目录
+            _log_fd = open(fileName, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644); // 再次尝试打开文件
         }
-        assert(_log_file_fp != nullptr);
+        assert(_log_fd >= 0);
     }
-}
 
-void Log::write(int level, const char* format, ...) {
-    struct timeval now = { 0, 0 };
-    // 获取当前时间戳和微秒
-    gettimeofday(&now, nullptr);
-    time_t tSec = now.tv_sec;
-    // 将时间戳转换为本地时间结构
-    struct tm* sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
-    va_list vaList;
+    if (maxQueueSize > 0) {
+        _is_async = true; // 启用异步写入模式
 
-    // 是否需要切换日志文件
-    if (_to_day != t.tm_mday || (_line_count && (_line_count % _log_max_lines == 0)))
-    {
-        unique_lock<mutex> locker(_mtx);
-        locker.unlock();
-        // 创建文件时释放锁
-        char newFile[LOG_NAME_LEN];
-        char tail[36] = { 0 };
-        // 将年、月、日信息格式化成字符串写入到tail里"YYYY_MM_DD
-        snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
-
-        // 将存储路径、日期字符串、后缀名拼接在一起，生成一个完整的文件路径字符串，用于创建日志文件
-        if (_to_day != t.tm_mday)
-        {
-            
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", _path, tail, _suffix);
-            _to_day = t.tm_mday;
-            _line_count = 0;
-        }
-        else {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", _path, tail, (_line_count / _log_max_lines), _suffix);
+        if (!_write_thread) {
+            // 启动异步线程把各线程缓冲区的数据刷到文件
+            std::unique_ptr<std::thread> NewThread(new thread(FlushLogThread));
+            _write_thread = move(NewThread);
         }
-
-        locker.lock();
-        flush();
-        // 关闭写满的文件
-        fclose(_log_file_fp);
-        // 追加模式打开创建新文件
-        _log_file_fp = fopen(newFile, "a");
-        assert(_log_file_fp != nullptr);
     }
+    else {
+        _is_async = false; // 关闭异步写入模式
+    }
+    // 二进制记录要由刷盘线程格式化，同步模式下仍写文本
+    _is_binary = binary && _is_async;
+    _is_open = true; // 标记日志系统为开启状态
+}
 
-    {
-        unique_lock<mutex> locker(_mtx);
-        _line_count++;
-        // 将日期和时间信息格式化为字符串，放入缓冲区
-        int n = snprintf(_buff.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
-            t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-            t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
+void Log::write(int level, const char* format, ...) {
+    // 时间取自主循环缓存的时钟，时间前缀按线程缓存，同一秒内不再调用 localtime
+    int64_t nowUs = CachedClock::WallUs();
+    const char* prefix = CachedClock::LogPrefix();
+    va_list vaList;
 
-        _buff.HasWritten(n);
-        // 根据日志等级，在缓冲区中添加相应的日志等级标题
-        AppendLogLevelTitle(level);
+    // 在线程自己的临时缓冲里格式化，不持有任何锁
+    char* line = t_line;
+    const size_t cap = LOG_LINE_MAX - 1;  // 预留换行符
+    size_t n = snprintf(line, cap, "%s.%06ld ", prefix, static_cast<long>(nowUs % 1000000));
+    n += AppendLogLevelTitle(level, line + n);
 
-        va_start(vaList, format);
-        // 使用格式化字符串和可变参数将日志内容添加到缓冲区
-        int m = vsnprintf(_buff.BeginWrite(), _buff.WritableBytes(), format, vaList);
-        va_end(vaList);
+    va_start(vaList, format);
+    // 使用格式化字符串和可变参数将日志内容添加到缓冲区
+    int m = vsnprintf(line + n, cap - n, format, vaList);
+    va_end(vaList);
+    if (m > 0) n += min(static_cast<size_t>(m), cap - n - 1);  // 超长截断
+    line[n++] = '\n';
 
-        _buff.HasWritten(m);
-        _buff.Append("\n\0", 2);
+    Push(level, line, n);
+}
+
+void Log::Push(int level, const char* line, size_t len) {
+    if (!_is_async) {
+        // 同步模式：直接写文件
+        struct iovec iov = { const_cast<char*>(line), len };
+        WriteFile(&iov, 1, 1);
+        return;
+    }
 
-        // 如果是异步模式并且阻塞队列未满，将缓冲区中的内容添加到阻塞队列
-        if (_is_async && _deque && !_deque->full()) {
-            _deque->push_back(_buff.RetrieveAllToStr());
+    LogRing* ring = LocalRing();
+    if (!ring->TryPush(line, len)) {
+        if (_overflow == OVERFLOW_DROP) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            _dropped_total.fetch_add(1, std::memory_order_relaxed);
+            WakeFlusher();
+            return;
         }
-        else {
-            // 否则将缓冲区中的内容写入日志文件
-            fputs(_buff.Peek(), _log_file_fp);
+        // 睡眠等待刷盘线程腾出空间，不自旋抢占 CPU；刷盘线程每取走一批通知一次，超时兜底漏掉的通知
+        unique_lock<mutex> locker(_space_mtx);
+        _space_waiters.fetch_add(1);
+        while (!ring->TryPush(line, len)) {
+            WakeFlusher();
+            _space_cond.wait_for(locker, chrono::milliseconds(_flush_interval_ms));
         }
-        _buff.RetrieveAll();
+        _space_waiters.fetch_sub(1);
+    }
+    // 缓冲区过半或错误日志时提前唤醒刷盘线程，否则等刷盘线程定时醒来
+    if (level >= 3 || ring->Used() * 2 >= ring->Capacity()) {
+        WakeFlusher();
     }
 }
 
-void Log::AppendLogLevelTitle(int level) {
+size_t Log::AppendLogLevelTitle(int level, char* buf) {
     // 添加日志级别标签
     switch (level) {
     case 0:
-        _buff.Append("[debug]: ", 9);
+        memcpy(buf, "[debug]: ", 9);
         break;
     case 1:
-        _buff.Append("[info] : ", 9);
+        memcpy(buf, "[info] : ", 9);
         break;
     case 2:
-        _buff.Append("[warn] : ", 9);
+        memcpy(buf, "[warn] : ", 9);
         break;
     case 3:
-        _buff.Append("[error]: ", 9);
+        memcpy(buf, "[error]: ", 9);
         break;
     default:
-        _buff.Append("[info] : ", 9);
+        memcpy(buf, "[info] : ", 9);
         break;
     }
+    return 9;
+}
+
+char* Log::BinaryScratch() {
+    return t_line;
+}
+
+LogRing* Log::LocalRing() {
+    if (!t_ring.ring) {
+        t_ring.ring = make_shared<LogRing>(_ring_size);
+        lock_guard<mutex> locker(_rings_mtx);
+        _rings.push_back(t_ring.ring);
+    }
+    return t_ring.ring.get();
+}
+
+void Log::WakeFlusher() {
+    if (_wake_pending.exchange(true, std::memory_order_acq_rel)) return;  // 已经有人唤醒过
+    lock_guard<mutex> locker(_flush_mtx);
+    _flush_cond.notify_one();
 }
 
 void Log::flush() {
-    // 刷新日志缓冲
+    // 唤醒刷盘线程，写文件由刷盘线程完成
     if (_is_async) {
-        _deque->flush();
+        WakeFlusher();
     }
-    // 将缓冲区中的数据写入到日志文件中
-    fflush(_log_file_fp);
+}
+
+size_t Log::FlushRings() {
+    {
+        // 取快照，回收线程已退出且已读空的缓冲区
+        lock_guard<mutex> locker(_rings_mtx);
+        for (size_t i = 0; i < _rings.size();) {
+            if (_rings[i]->IsDetached() && _rings[i]->Used() == 0) {
+                _rings[i] = _rings.back();
+                _rings.pop_back();
+            }
+            else {
+                i++;
+            }
+        }
+        _flush_rings.assign(_rings.begin(), _rings.end());
+    }
+
+    _flush_iov.clear();
+    _flush_bytes.clear();
+    _format_buf.clear();
+    size_t total = 0;
+    size_t lines = 0;
+    // 文本模式下各缓冲区的可读区域直接作为 iovec 写入文件，不再拷贝；
+    // 二进制模式下先把记录格式化到 _format_buf
+    for (auto& ring : _flush_rings) {
+        struct iovec iov[2];
+        size_t n = ring->Peek(iov);
+        _flush_bytes.push_back(n);
+        if (_is_binary) {
+            lines += DecodeBinary(iov, n);
+            continue;
+        }
+        for (int k = 0; k < 2; k++) {
+            if (iov[k].iov_len == 0) continue;
+            _flush_iov.push_back(iov[k]);
+            const char* p = static_cast<const char*>(iov[k].iov_base);
+            const char* end = p + iov[k].iov_len;
+            while ((p = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr) {
+                lines++;
+                p++;
+            }
+        }
+        total += n;
+    }
+    if (!_format_buf.empty()) {
+        _flush_iov.push_back({ _format_buf.data(), _format_buf.size() });
+        total += _format_buf.size();
+    }
+
+    uint64_t dropped = _dropped.exchange(0, std::memory_order_relaxed);
+    char dropLine[128];
+    if (dropped > 0) {
+        int64_t nowUs = CachedClock::WallUs();
+        int n = snprintf(dropLine, sizeof(dropLine), "%s.%06ld [warn] : 日志缓冲区已满，丢弃 %llu 行\n",
+            CachedClock::LogPrefix(), static_cast<long>(nowUs % 1000000), static_cast<unsigned long long>(dropped));
+        _flush_iov.push_back({ dropLine, static_cast<size_t>(n) });
+        total += n;
+        lines++;
+    }
+    char badLine[128];
+    if (_bad_records > 0) {
+        int64_t nowUs = CachedClock::WallUs();
+        int n = snprintf(badLine, sizeof(badLine), "%s.%06ld [warn] : 二进制日志记录损坏，跳过 %llu 条\n",
+            CachedClock::LogPrefix(), static_cast<long>(nowUs % 1000000), static_cast<unsigned long long>(_bad_records));
+        _flush_iov.push_back({ badLine, static_cast<size_t>(n) });
+        total += n;
+        lines++;
+        _bad_records = 0;
+    }
+
+    if (total > 0) {
+        WriteFile(_flush_iov.data(), static_cast<int>(_flush_iov.size()), lines);
+        // 写完后再移动各缓冲区的读位置，写线程此时才能覆盖这段空间
+        for (size_t i = 0; i < _flush_rings.size(); i++) {
+            if (_flush_bytes[i] > 0) _flush_rings[i]->Consume(_flush_bytes[i]);
+        }
+    }
+    return total;
+}
+
+namespace {
+
+// 从可能绕回的两段区域中拷贝出 [pos, pos + len)
+void CopyOut(const struct iovec iov[2], size_t pos, char* dst, size_t len) {
+    size_t first = iov[0].iov_len;
+    if (pos < first) {
+        size_t k = min(len, first - pos);
+        memcpy(dst, static_cast<const char*>(iov[0].iov_base) + pos, k);
+        dst += k;
+        len -= k;
+        pos = first;
+    }
+    if (len > 0) {
+        memcpy(dst, static_cast<const char*>(iov[1].iov_base) + (pos - first), len);
+    }
+}
+
+}
+
+size_t Log::DecodeBinary(const struct iovec iov[2], size_t bytes) {
+    char rec[LOG_LINE_MAX];
+    size_t pos = 0;
+    size_t lines = 0;
+    while (pos + sizeof(BinaryHeader) <= bytes) {
+        uint32_t len;
+        CopyOut(iov, pos, reinterpret_cast<char*>(&len), sizeof(len));
+        if (len < sizeof(BinaryHeader) || len > LOG_LINE_MAX || pos + len > bytes) {
+            // 记录长度损坏，后面的记录边界无法确定，本批剩余部分整体跳过
+            _bad_records++;
+            _bad_total.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        CopyOut(iov, pos, rec, len);
+        if (!FormatRecord(rec, len)) {
+            _bad_records++;
+            _bad_total.fetch_add(1, std::memory_order_relaxed);
+        }
+        pos += len;
+        lines++;
+    }
+    return lines;
+}
+
+bool Log::FormatRecord(const char* rec, size_t len) {
+    BinaryHeader header;
+    memcpy(&header, rec, sizeof(header));
+    const char* arg = rec + sizeof(header);
+    const char* argEnd = rec + len;
+
+    // 时间前缀，同一秒内复用
+    int64_t sec = header.us / 1000000;
+    if (sec != _format_sec) {
+        time_t tSec = static_cast<time_t>(sec);
+        struct tm t;
+        localtime_r(&tSec, &t);
+        snprintf(_format_prefix, sizeof(_format_prefix), "%d-%02d-%02d %02d:%02d:%02d",
+            t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+        _format_sec = sec;
+    }
+    char tmp[LOG_LINE_MAX];
+    int n = snprintf(tmp, sizeof(tmp), "%s.%06ld ", _format_prefix, static_cast<long>(header.us % 1000000));
+    n += AppendLogLevelTitle(header.level, tmp + n);
+    _format_buf.insert(_format_buf.end(), tmp, tmp + n);
+
+    // 逐个转换说明符取参数格式化，其余字符原样输出
+    bool ok = true;
+    const char* f = header.format;
+    while (*f) {
+        if (*f != '%') {
+            const char* next = strchr(f, '%');
+            if (!next) next = f + strlen(f);
+            _format_buf.insert(_format_buf.end(), f, next);
+            f = next;
+            continue;
+        }
+        if (f[1] == '%') {
+            _format_buf.push_back('%');
+            f += 2;
+            continue;
+        }
+        // 解析 %[flags][width][.precision][length]conversion，去掉长度修饰，按记录的参数类型重新拼
+        char spec[32];
+        size_t k = 0;
+        spec[k++] = *f++;
+        while (*f && strchr("-+ #0", *f) && k < 16) spec[k++] = *f++;
+        while (*f && ((*f >= '0' && *f <= '9') || *f == '.') && k < 24) spec[k++] = *f++;
+        while (*f && strchr("hlLqjzt", *f)) f++;
+        char conv = *f ? *f++ : 's';
+
+        if (arg >= argEnd) {
+            _format_buf.insert(_format_buf.end(), { '<', '?', '>' });
+            continue;
+        }
+        uint8_t type = static_cast<uint8_t>(*arg++);
+        int m = 0;
+        if (type == ARG_INT || type == ARG_UINT || type == ARG_PTR || type == ARG_DOUBLE) {
+            if (argEnd - arg < static_cast<ptrdiff_t>(sizeof(uint64_t))) {
+                ok = false;
+                break;
+            }
+        }
+        if (type == ARG_INT || type == ARG_UINT || type == ARG_PTR) {
+            uint64_t v;
+            memcpy(&v, arg, sizeof(v));
+            arg += sizeof(v);
+            if (type == ARG_PTR || conv == 'p') {
+                m = snprintf(tmp, sizeof(tmp), "%p", reinterpret_cast<void*>(static_cast<uintptr_t>(v)));
+            }
+            else if (strchr("fFeEgGaA", conv)) {
+                spec[k++] = conv;
+                spec[k] = '\0';
+                m = snprintf(tmp, sizeof(tmp), spec, type == ARG_INT ? static_cast<double>(static_cast<int64_t>(v)) : static_cast<double>(v));
+            }
+            else if (conv == 'c') {
+                spec[k++] = 'c';
+                spec[k] = '\0';
+                m = snprintf(tmp, sizeof(tmp), spec, static_cast<int>(v));
+            }
+            else {
+                if (!strchr("diuxXo", conv)) conv = type == ARG_INT ? 'd' : 'u';
+                spec[k++] = 'l';
+                spec[k++] = 'l';
+                spec[k++] = conv;
+                spec[k] = '\0';
+                if (conv == 'd' || conv == 'i') m = snprintf(tmp, sizeof(tmp), spec, static_cast<long long>(static_cast<int64_t>(v)));
+                else m = snprintf(tmp, sizeof(tmp), spec, static_cast<unsigned long long>(v));
+            }
+        }
+        else if (type == ARG_DOUBLE) {
+            double v;
+            memcpy(&v, arg, sizeof(v));
+            arg += sizeof(v);
+            spec[k++] = strchr("fFeEgGaA", conv) ? conv : 'g';
+            spec[k] = '\0';
+            m = snprintf(tmp, sizeof(tmp), spec, v);
+        }
+        else if (type == ARG_STR) {
+            uint16_t l;
+            if (argEnd - arg < static_cast<ptrdiff_t>(sizeof(l))) {
+                ok = false;
+                break;
+            }
+            memcpy(&l, arg, sizeof(l));
+            arg += sizeof(l);
+            if (argEnd - arg < l) {
+                ok = false;
+                break;
+            }
+            // 字符串不含结尾 0，用 %.*s 限制在拷贝的长度内，原有精度取较小值
+            int prec = l;
+            const char* dot = static_cast<const char*>(memchr(spec, '.', k));
+            if (dot) {
+                spec[k] = '\0';
+                prec = min(prec, atoi(dot + 1));
+                k = dot - spec;
+            }
+            spec[k++] = '.';
+            spec[k++] = '*';
+            spec[k++] = 's';
+            spec[k] = '\0';
+            m = snprintf(tmp, sizeof(tmp), spec, prec, arg);
+            arg += l;
+        }
+        else {
+            ok = false;  // 记录损坏，不再继续解析
+            break;
+        }
+        if (m > 0) {
+            _format_buf.insert(_format_buf.end(), tmp, tmp + min(static_cast<size_t>(m), sizeof(tmp) - 1));
+        }
+    }
+    if (!ok) {
+        _format_buf.insert(_format_buf.end(), { '<', '!', '>' });
+    }
+    _format_buf.push_back('\n');
+    return ok;
+}
+
+void Log::WriteFile(const struct iovec* iov, int cnt, size_t lines) {
+    lock_guard<mutex> locker(_mtx);
+    RotateIfNeeded();
+    // writev 一次最多 IOV_MAX 段，处理部分写入
+    while (cnt > 0) {
+        int batch = min(cnt, IOV_MAX);
+        ssize_t n = ::writev(_log_fd, iov, batch);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        size_t left = static_cast<size_t>(n);
+        while (batch > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            cnt--;
+            batch--;
+        }
+        if (left > 0) {
+            // 部分写入，剩余部分单独写完
+            const char* p = static_cast<const char*>(iov->iov_base) + left;
+            size_t rest = iov->iov_len - left;
+            while (rest > 0) {
+                ssize_t m = ::write(_log_fd, p, rest);
+                if (m < 0) {
+                    if (errno == EINTR) continue;
+                    return;
+                }
+                p += m;
+                rest -= m;
+            }
+            iov++;
+            cnt--;
+        }
+    }
+    _line_count += lines;
+}
+
+void Log::RotateIfNeeded() {
+    time_t tSec = time(nullptr);
+    struct tm t;
+    localtime_r(&tSec, &t);
+
+    // 是否需要切换日志文件（按批检查，一个文件可能多出最后一批的行数）
+    if (_to_day == t.tm_mday && _line_count < _log_max_lines) {
+        return;
+    }
+    char newFile[LOG_NAME_LEN];
+    char tail[36] = { 0 };
+    // 将年、月、日信息格式化成字符串写入到tail里"YYYY_MM_DD
+    snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+
+    // 将存储路径、日期字符串、后缀名拼接在一起，生成一个完整的文件路径字符串，用于创建日志文件
+    if (_to_day != t.tm_mday) {
+        snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", _path.c_str(), tail, _suffix.c_str());
+        _to_day = t.tm_mday;
+        _file_index = 0;
+    }
+    else {
+        _file_index++;
+        snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", _path.c_str(), tail, _file_index, _suffix.c_str());
+    }
+    _line_count = 0;
+
+    // 关闭写满的文件，追加模式打开创建新文件
+    close(_log_fd);
+    _log_fd = open(newFile, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    assert(_log_fd >= 0);
 }
 
 void Log::AsyncWrite() {
-    // 异步写日志
-    string str = "";
-    while (_deque->pop(str)) {
-        lock_guard<mutex> locker(_mtx);
-        fputs(str.c_str(), _log_file_fp);
+    // 定时或被唤醒后把所有线程缓冲区批量写入文件
+    while (true) {
+        bool stop;
+        {
+            unique_lock<mutex> locker(_flush_mtx);
+            _flush_cond.wait_for(locker, chrono::milliseconds(_flush_interval_ms), [this] {
+                return _wake_pending.load(std::memory_order_acquire) || _stop;
+            });
+            stop = _stop;
+        }
+        _wake_pending.store(false, std::memory_order_release);
+        size_t n = FlushRings();
+        if (_space_waiters.load() > 0) {
+            lock_guard<mutex> locker(_space_mtx);
+            _space_cond.notify_all();  // 唤醒等待缓冲区空间的线程
+        }
+        if (stop && n == 0) break;
     }
 }
 
@@ -217,6 +637,6 @@ Log* Log::Instance() {
 
 void Log::FlushLogThread() {
     // 异步写日志线程函数
+    ThreadAffinity::Instance()->Apply(ThreadAffinity::LOG);
     Log::Instance()->AsyncWrite();
 }
-
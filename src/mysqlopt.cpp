@@ -1,10 +1,36 @@
 #include "../include/mysqlopt.h"
 #include "../include/log.h"
 #include "../include/QString.hpp"
+#include "../include/registerbatcher.h"
 
 
-// 注册功能
+UserStore* MysqlOpt::_store = MysqlUserStore::Instance();
+
+void MysqlOpt::SetStore(UserStore* store) {
+    assert(store);
+    _store = store;
+}
+
 int MysqlOpt::Register(const std::string& name, const std::string& phone, const std::string& passwd) {
+    return _store->Register(name, phone, passwd);
+}
+
+int MysqlOpt::Login(const std::string& name, const std::string& passwd) {
+    return _store->Login(name, passwd);
+}
+
+
+MysqlUserStore* MysqlUserStore::Instance() {
+    static MysqlUserStore store;
+    return &store;
+}
+
+// 注册功能
+int MysqlUserStore::Register(const std::string& name, const std::string& phone, const std::string& passwd) {
+    // 开启写合并时交给合并器批量提交
+    if (RegisterBatcher::Instance()->IsOpen()) {
+        return RegisterBatcher::Instance()->Submit(name, phone, passwd);
+    }
     SqlConnRAII connRAII(SqlConnPool::Instance());
     std::string query = QString("SELECT * FROM users WHERE phone_number='%0'").arg(phone).toStdString();
 
@@ -29,7 +55,7 @@ int MysqlOpt::Register(const std::string& name, const std::string& phone, const
  
 // 登录功能
     
-int MysqlOpt::Login(const std::string& name, const std::string& passwd) {
+int MysqlUserStore::Login(const std::string& name, const std::string& passwd) {
     SqlConnRAII connRAII(SqlConnPool::Instance());
     std::string query = QString("SELECT * FROM users WHERE (name='%0' OR phone_number='%1') AND passwd='%2'").arg(name).arg(name).arg(passwd).toStdString();
     std::vector<std::vector<std::string>> queryResult = connRAII.Query(query);
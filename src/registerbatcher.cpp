@@ -0,0 +1,168 @@
+#include "../include/registerbatcher.h"
+#include "../include/log.h"
+
+#include <unordered_map>
+#include <algorithm>
+
+using namespace std;
+
+RegisterBatcher::RegisterBatcher() {
+    _max_rows = 64;
+    _max_wait_ms = 5;
+    _is_open = false;
+}
+
+RegisterBatcher::~RegisterBatcher() {
+    Close();
+}
+
+// 单例
+RegisterBatcher* RegisterBatcher::Instance() {
+    static RegisterBatcher batcher;
+    return &batcher;
+}
+
+void RegisterBatcher::Init(int maxRows, int maxWaitMs) {
+    assert(maxRows > 0 && maxWaitMs >= 0);
+    lock_guard<mutex> locker(_mtx);
+    if (_is_open) return;
+    _max_rows = maxRows;
+    _max_wait_ms = maxWaitMs;
+    _is_open = true;
+    _commit_thread.reset(new thread(&RegisterBatcher::Run, this));
+}
+
+void RegisterBatcher::Close() {
+    {
+        lock_guard<mutex> locker(_mtx);
+        if (!_is_open) return;
+        _is_open = false;
+    }
+    _cond.notify_all();
+    // 提交线程会先把队列里剩余的请求提交完再退出
+    if (_commit_thread && _commit_thread->joinable()) {
+        _commit_thread->join();
+    }
+}
+
+int RegisterBatcher::Submit(const string& name, const string& phone, const string& passwd) {
+    unique_ptr<Pending> item(new Pending);
+    item->name = name;
+    item->phone = phone;
+    item->passwd = passwd;
+    future<int> result = item->result.get_future();
+    bool notify = false;
+    {
+        lock_guard<mutex> locker(_mtx);
+        if (!_is_open) {
+            return -1;
+        }
+        _queue.push_back(move(item));
+        // 队列由空变为非空或凑够一批时唤醒提交线程
+        notify = _queue.size() == 1 || _queue.size() >= static_cast<size_t>(_max_rows);
+    }
+    if (notify) {
+        _cond.notify_one();
+    }
+    return result.get();
+}
+
+void RegisterBatcher::Run() {
+    while (true) {
+        Batch batch;
+        {
+            unique_lock<mutex> locker(_mtx);
+            _cond.wait(locker, [this] { return !_queue.empty() || !_is_open; });
+            if (_queue.empty()) break;  // 已关闭且队列已清空
+
+            // 第一条请求到达后最多再等待 _max_wait_ms，凑够 _max_rows 行提前提交
+            auto deadline = chrono::steady_clock::now() + chrono::milliseconds(_max_wait_ms);
+            _cond.wait_until(locker, deadline, [this] {
+                return _queue.size() >= static_cast<size_t>(_max_rows) || !_is_open;
+            });
+
+            size_t n = min(_queue.size(), static_cast<size_t>(_max_rows));
+            batch.reserve(n);
+            for (size_t i = 0; i < n; i++) {
+                batch.push_back(move(_queue[i]));
+            }
+            _queue.erase(_queue.begin(), _queue.begin() + n);
+        }
+        CommitBatch(batch);
+    }
+}
+
+void RegisterBatcher::CommitBatch(Batch& batch) {
+    vector<int> res(batch.size(), 0);
+    SqlConnRAII conn(SqlConnPool::Instance(), CONN_WAIT_MS);
+
+    if (!conn.IsValid()) {
+        LOG_WARN("注册批量提交获取数据库连接失败，批大小：%d", (int)batch.size());
+        fill(res.begin(), res.end(), -1);
+    }
+    else {
+        // 同一批内的重复手机号，只保留第一条，其余按手机号已存在处理
+        unordered_map<string, size_t> phones;
+        string inList;
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (!phones.emplace(batch[i]->phone, i).second) {
+                res[i] = -2;
+                continue;
+            }
+            if (!inList.empty()) inList += ",";
+            inList += "'" + conn.Escape(batch[i]->phone) + "'";
+        }
+
+        // 一次查询找出库中已存在的手机号
+        string query = "SELECT phone_number FROM users WHERE phone_number IN (" + inList + ")";
+        vector<vector<string>> queryResult = conn.Query(query);
+        for (const auto& row : queryResult) {
+            auto it = phones.find(row[0]);
+            if (it != phones.end()) {
+                res[it->second] = -2;
+            }
+        }
+
+        // 剩余的行拼成一条多行 INSERT
+        string values;
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (res[i] != 0) continue;
+            if (!values.empty()) values += ",";
+            values += "('" + conn.Escape(batch[i]->name) + "','" + conn.Escape(batch[i]->phone)
+                + "','" + conn.Escape(batch[i]->passwd) + "')";
+        }
+
+        if (!values.empty()) {
+            query = "INSERT INTO users (name, phone_number, passwd) VALUES " + values;
+            if (!conn.Begin() || !conn.Execute(query) || !conn.Commit()) {
+                // 整批失败（例如与其他节点并发插入了同一手机号），回滚后逐行提交得到每行的结果
+                conn.Rollback();
+                LOG_WARN("注册批量提交失败，改为逐行提交，批大小：%d", (int)batch.size());
+                CommitOneByOne(conn, batch, res);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        batch[i]->result.set_value(res[i]);
+    }
+    LOG_DEBUG("注册批量提交完成，批大小：%d", (int)batch.size());
+}
+
+void RegisterBatcher::CommitOneByOne(SqlConnRAII& conn, Batch& batch, vector<int>& res) {
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (res[i] != 0) continue;
+        string phone = conn.Escape(batch[i]->phone);
+        string query = "SELECT * FROM users WHERE phone_number='" + phone + "'";
+        if (!conn.Query(query).empty()) {
+            res[i] = -2;  // 手机号已存在
+            continue;
+        }
+        query = "INSERT INTO users (name, phone_number, passwd) VALUES ('" + conn.Escape(batch[i]->name)
+            + "','" + phone + "','" + conn.Escape(batch[i]->passwd) + "')";
+        if (!conn.Execute(query)) {
+            LOG_WARN("%s 执行失败", query.c_str());
+            res[i] = -1;
+        }
+    }
+}
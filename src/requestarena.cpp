@@ -0,0 +1,71 @@
+#include "../include/requestarena.h"
+
+#include <new>
+#include <stdint.h>
+
+static size_t AlignedOffset(const BufferChunk* chunk, size_t offset, size_t alignment) {
+    uintptr_t base = reinterpret_cast<uintptr_t>(chunk->data);
+    return ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+}
+
+RequestArena::RequestArena()
+    : _head(nullptr), _current(nullptr), _offset(0), _chunk_count(0), _large(nullptr), _large_bytes(0) {}
+
+RequestArena::~RequestArena() {
+    Release();
+}
+
+void RequestArena::Release() {
+    Reset();
+    if (_head) {
+        BufferChunkPool::Instance()->Free(_head);
+        _head = nullptr;
+        _current = nullptr;
+        _chunk_count = 0;
+    }
+}
+
+void RequestArena::Reset() {
+    while (_large) {
+        LargeBlock* next = _large->next;
+        ::operator delete(_large);
+        _large = next;
+    }
+    _large_bytes = 0;
+    if (_head && _head->next) {
+        BufferChunkPool::Instance()->Free(_head->next);
+        _head->next = nullptr;
+        _chunk_count = 1;
+    }
+    _current = _head;
+    _offset = 0;
+}
+
+void* RequestArena::do_allocate(size_t bytes, size_t alignment) {
+    assert(alignment <= alignof(std::max_align_t));
+    if (bytes > BufferChunk::SIZE / 2) {
+        // 大对象（通常是很长的请求体）单独申请，避免浪费块的剩余空间
+        LargeBlock* block = static_cast<LargeBlock*>(::operator new(LARGE_HEADER + bytes));
+        block->next = _large;
+        _large = block;
+        _large_bytes += LARGE_HEADER + bytes;
+        return reinterpret_cast<char*>(block) + LARGE_HEADER;
+    }
+    // 按实际地址对齐（块内数据区本身只保证指针大小对齐）
+    size_t offset = _current ? AlignedOffset(_current, _offset, alignment) : 0;
+    if (_current == nullptr || offset + bytes > BufferChunk::SIZE) {
+        BufferChunk* chunk = BufferChunkPool::Instance()->Alloc();
+        chunk->next = nullptr;
+        if (_current) {
+            _current->next = chunk;
+        }
+        else {
+            _head = chunk;
+        }
+        _current = chunk;
+        _chunk_count++;
+        offset = AlignedOffset(chunk, 0, alignment);
+    }
+    _offset = offset + bytes;
+    return _current->data + offset;
+}
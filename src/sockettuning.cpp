@@ -0,0 +1,82 @@
+#include "../include/sockettuning.h"
+#include "../include/log.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+SocketTuning::SocketTuning() {
+    _backlog = 1024;
+    _no_delay = true;
+    _cork = true;
+    _defer_accept_sec = 0;
+    _fast_open_queue = 0;
+    _rcv_buf = 0;
+    _snd_buf = 0;
+    _busy_poll_us = 0;
+}
+
+// 单例
+SocketTuning* SocketTuning::Instance() {
+    static SocketTuning tuning;
+    return &tuning;
+}
+
+void SocketTuning::Init(int backlog, bool noDelay, bool cork, int deferAcceptSec, int fastOpenQueue,
+    int rcvBuf, int sndBuf, int busyPollUs) {
+    _backlog = backlog > 0 ? backlog : 1024;
+    _no_delay = noDelay;
+    _cork = cork;
+    _defer_accept_sec = deferAcceptSec > 0 ? deferAcceptSec : 0;
+    _fast_open_queue = fastOpenQueue > 0 ? fastOpenQueue : 0;
+    _rcv_buf = rcvBuf > 0 ? rcvBuf : 0;
+    _snd_buf = sndBuf > 0 ? sndBuf : 0;
+    _busy_poll_us = busyPollUs > 0 ? busyPollUs : 0;
+
+    // listen 的排队长度会被 somaxconn 截断，配置更大时提示
+    FILE* fp = fopen("/proc/sys/net/core/somaxconn", "r");
+    if (fp) {
+        int somaxconn = 0;
+        if (fscanf(fp, "%d", &somaxconn) == 1 && somaxconn < _backlog) {
+            LOG_WARN("监听队列长度%d超过 net.core.somaxconn（%d），实际按%d生效", _backlog, somaxconn, somaxconn);
+        }
+        fclose(fp);
+    }
+}
+
+void SocketTuning::ApplyListen(int fd) const {
+    int on = 1;
+    if (_no_delay && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0) {
+        LOG_WARN("设置TCP_NODELAY失败：%s", strerror(errno));
+    }
+    // 收缓冲区要在 listen 之前设置，三次握手时才能按它协商窗口扩大因子
+    if (_rcv_buf > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &_rcv_buf, sizeof(_rcv_buf)) < 0) {
+        LOG_WARN("设置SO_RCVBUF失败：%s", strerror(errno));
+    }
+    if (_snd_buf > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &_snd_buf, sizeof(_snd_buf)) < 0) {
+        LOG_WARN("设置SO_SNDBUF失败：%s", strerror(errno));
+    }
+    // 客户端发来数据后才完成 accept，只连不发的连接不占用主循环和连接对象
+    if (_defer_accept_sec > 0 && setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &_defer_accept_sec, sizeof(_defer_accept_sec)) < 0) {
+        LOG_WARN("设置TCP_DEFER_ACCEPT失败：%s", strerror(errno));
+    }
+    // 服务端 Fast Open 还需要 net.ipv4.tcp_fastopen 打开第 2 位
+    if (_fast_open_queue > 0 && setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &_fast_open_queue, sizeof(_fast_open_queue)) < 0) {
+        LOG_WARN("设置TCP_FASTOPEN失败：%s", strerror(errno));
+    }
+    // 调大 busy poll 时间需要 CAP_NET_ADMIN
+    if (_busy_poll_us > 0 && setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &_busy_poll_us, sizeof(_busy_poll_us)) < 0) {
+        LOG_WARN("设置SO_BUSY_POLL失败：%s", strerror(errno));
+    }
+    LOG_INFO("监听队列：%d，TCP_NODELAY：%s，TCP_CORK：%s，DEFER_ACCEPT：%ds，FASTOPEN：%d，收发缓冲区：%d/%d，BUSY_POLL：%dus",
+        _backlog, _no_delay ? "on" : "off", _cork ? "on" : "off", _defer_accept_sec, _fast_open_queue,
+        _rcv_buf, _snd_buf, _busy_poll_us);
+}
+
+void SocketTuning::SetCork(int fd, bool on) {
+    int val = on ? 1 : 0;
+    setsockopt(fd, IPPROTO_TCP, TCP_CORK, &val, sizeof(val));
+}
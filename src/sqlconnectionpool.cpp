@@ -1,7 +1,10 @@
 #include "../include/sqlconnectionpool.h"
+#include <errno.h>
+#include <time.h>
 using namespace std;
 
 SqlConnPool::SqlConnPool() {
+    _MAX_CON_COUNT = 0;
     _user_count = 0;
     _free_count = 0;
 }
@@ -52,6 +55,34 @@ MYSQL* SqlConnPool::GetConn() {
     return sql;
 }
 
+// 获取数据库连接，池空时等待其他线程归还，超时返回 nullptr
+MYSQL* SqlConnPool::GetConn(int timeoutMs) {
+    if (_MAX_CON_COUNT == 0) {
+        return nullptr;  // 连接池未初始化
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (sem_timedwait(&_semId, &deadline) != 0) {
+        if (errno != EINTR) {
+            LOG_WARN("SqlConnPool 繁忙，等待 %dms 后仍没有空闲连接！", timeoutMs);
+            return nullptr;
+        }
+    }
+    MYSQL* sql = nullptr;
+    {
+        lock_guard<mutex> locker(_mtx);
+        sql = _conn_que.front();
+        _conn_que.pop();
+    }
+    return sql;
+}
+
 // 释放数据库连接
 void SqlConnPool::FreeConn(MYSQL* sql) {
     assert(sql);
@@ -0,0 +1,175 @@
+#include "../include/timingwheel.h"
+#include "../include/log.h"
+#include "../include/cachedclock.h"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+TimingWheel::TimingWheel(int tickMs) {
+    _tick_ms = tickMs > 0 ? tickMs : 1;
+    _armed = false;
+    _count = 0;
+    for (int i = 0; i < ROOT_SIZE; i++) {
+        InitList(&_root[i]);
+    }
+    for (int l = 0; l < LEVELS; l++) {
+        for (int i = 0; i < LEVEL_SIZE; i++) {
+            InitList(&_levels[l][i]);
+        }
+    }
+    _timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (_timer_fd < 0) {
+        LOG_ERROR("创建 timerfd 失败！");
+    }
+    _start_ms = 0;
+    _start_ms = NowTick() * _tick_ms;
+    _current = 0;
+}
+
+TimingWheel::~TimingWheel() {
+    if (_timer_fd >= 0) {
+        close(_timer_fd);
+    }
+}
+
+void TimingWheel::Unlink(TimerNode* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = nullptr;
+}
+
+void TimingWheel::LinkTail(TimerNode* head, TimerNode* node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+void TimingWheel::Place(TimerNode* node) {
+    int64_t expires = node->expires;
+    int64_t delta = expires - _current;
+    TimerNode* head;
+    if (delta < 0) {
+        // 已经过期，放到当前槽，下一个 tick 执行
+        head = &_root[_current & ROOT_MASK];
+    }
+    else if (delta < ROOT_SIZE) {
+        head = &_root[expires & ROOT_MASK];
+    }
+    else {
+        if (delta > MAX_TICKS) {
+            // 超出时间轮范围，放在最高层最远的槽，到时再重新放置
+            expires = _current + MAX_TICKS;
+        }
+        int level = 0;
+        int shift = ROOT_BITS + LEVEL_BITS;
+        while (level < LEVELS - 1 && delta >= (int64_t(1) << shift)) {
+            level++;
+            shift += LEVEL_BITS;
+        }
+        shift -= LEVEL_BITS;
+        head = &_levels[level][(expires >> shift) & LEVEL_MASK];
+    }
+    LinkTail(head, node);
+}
+
+bool TimingWheel::Cascade(int level, int index) {
+    TimerNode work;
+    InitList(&work);
+    TimerNode* head = &_levels[level][index];
+    if (head->next != head) {
+        // 整个槽的链表搬到临时链表，再逐个重新放置
+        work.next = head->next;
+        work.prev = head->prev;
+        work.next->prev = &work;
+        work.prev->next = &work;
+        InitList(head);
+    }
+    while (work.next != &work) {
+        TimerNode* node = work.next;
+        Unlink(node);
+        Place(node);
+    }
+    return index == 0;
+}
+
+void TimingWheel::RunOneTick() {
+    int index = _current & ROOT_MASK;
+    // 第 0 层转完一圈时，从高层依次下放下一段的节点
+    if (index == 0) {
+        for (int l = 0; l < LEVELS; l++) {
+            int shift = ROOT_BITS + l * LEVEL_BITS;
+            if (!Cascade(l, (_current >> shift) & LEVEL_MASK)) break;
+        }
+    }
+    _current++;
+
+    TimerNode* head = &_root[index];
+    // 回调里可能删除或添加其他节点，每次只取链表头
+    while (head->next != head) {
+        TimerNode* node = head->next;
+        Unlink(node);
+        _count--;
+        if (_callback) _callback(node);
+    }
+}
+
+void TimingWheel::add(TimerNode* node, int timeoutMs) {
+    assert(node);
+    if (node->IsLinked()) {
+        Unlink(node);
+    }
+    else {
+        if (_count == 0) {
+            // 时间轮空闲期间 timerfd 已停止，先追上当前时间
+            _current = NowTick();
+            Arm();
+        }
+        _count++;
+    }
+    // 向上取整到 tick，保证不会提前到期
+    int64_t ticks = (static_cast<int64_t>(timeoutMs) + _tick_ms - 1) / _tick_ms;
+    node->expires = _current + (ticks > 0 ? ticks : 1);
+    Place(node);
+}
+
+void TimingWheel::del(TimerNode* node) {
+    assert(node);
+    if (!node->IsLinked()) return;
+    Unlink(node);
+    _count--;
+}
+
+void TimingWheel::tick() {
+    uint64_t expirations = 0;
+    ssize_t n = read(_timer_fd, &expirations, sizeof(expirations));  // 清除可读状态
+    (void)n;
+    int64_t now = NowTick();
+    while (_current <= now && _count > 0) {
+        RunOneTick();
+    }
+    if (_count == 0) {
+        Disarm();
+    }
+}
+
+int64_t TimingWheel::NowTick() const {
+    return (CachedClock::MonoMs() - _start_ms) / _tick_ms;
+}
+
+void TimingWheel::Arm() {
+    if (_armed || _timer_fd < 0) return;
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = _tick_ms / 1000;
+    spec.it_interval.tv_nsec = (_tick_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(_timer_fd, 0, &spec, nullptr);
+    _armed = true;
+}
+
+void TimingWheel::Disarm() {
+    if (!_armed || _timer_fd < 0) return;
+    struct itimerspec spec = {};
+    timerfd_settime(_timer_fd, 0, &spec, nullptr);
+    _armed = false;
+}
@@ -13,23 +13,139 @@ WebServer::WebServer() {
   std::string root_dir = config->GetString("server", "root_dir", "./");
   _src_root_dir = new char[root_dir.size() + 1]();
   strncpy(_src_root_dir, root_dir.c_str(), root_dir.size());
-  _timeout_MS = config->GetInt("server", "timeout_Ms", 60000);
   _max_fd = config->GetInt("server", "_max_fd", 1024);
+  _timeout_MS = config->GetInt("server", "timeout_Ms", 60000);
+  // 分阶段超时：请求头、请求体从进入阶段起计时，读到数据不延长；写响应按最后一次写出进展计时
+  _phase_timeout_MS[HttpConn::IDLE] = config->GetInt("server", "idle_timeout_Ms", _timeout_MS);
+  _phase_timeout_MS[HttpConn::READ_HEADER] = config->GetInt("server", "header_timeout_Ms", std::min(_timeout_MS, 10000));
+  _phase_timeout_MS[HttpConn::READ_BODY] = config->GetInt("server", "body_timeout_Ms", _timeout_MS);
+  _phase_timeout_MS[HttpConn::WRITE] = config->GetInt("server", "write_timeout_Ms", _timeout_MS);
+  _phase_timeout_MS[HttpConn::ABORT] = _phase_timeout_MS[HttpConn::READ_HEADER];
+  // 定时器不跟随每个事件刷新，最长隔这么久检查一次连接所处阶段，取各阶段超时的最小值
+  _timer_check_MS = _timeout_MS;
+  for (int& timeout : _phase_timeout_MS) {
+    if (timeout <= 0) timeout = _timeout_MS;
+    _timer_check_MS = std::min(_timer_check_MS, timeout);
+  }
+  // keep-alive：每连接请求数上限；连接数超过压力线后空闲超时线性缩短到最小值，并从最老的空闲连接开始关闭
+  HttpConn::_keep_alive_max = config->GetInt("server", "keep_alive_max", 100);
+  HttpResponse::_keep_alive_timeout = _timeout_MS > 0 ? _phase_timeout_MS[HttpConn::IDLE] / 1000 : 0;
+  _idle_pressure_users = static_cast<int>(static_cast<int64_t>(_max_fd) * config->GetInt("server", "idle_pressure_pct", 80) / 100);
+  _idle_min_timeout_MS = config->GetInt("server", "idle_min_timeout_Ms", 1000);
+  // 准入控制：单 IP 并发连接数、请求速率，全局新建连接速率，超限回复 503
+  int per_ip_conns = config->GetInt("admission", "per_ip_conns", 0);
+  int per_ip_rate = config->GetInt("admission", "per_ip_rate", 0);
+  int conn_rate = config->GetInt("admission", "conn_rate", 0);
+  Admission::Instance()->Init(config->GetInt("admission", "ip_table_size", 65536),
+      per_ip_conns, per_ip_rate, config->GetInt("admission", "per_ip_burst", 0),
+      conn_rate, config->GetInt("admission", "conn_burst", 0), config->GetInt("admission", "retry_after", 1));
+  // 套接字调优：监听队列长度和 TCP 选项，设置在监听套接字上由连接继承
+  SocketTuning::Instance()->Init(config->GetInt("socket", "backlog", 1024),
+      config->GetString("socket", "tcp_nodelay", "on") == "on",
+      config->GetString("socket", "tcp_cork", "on") == "on",
+      config->GetInt("socket", "defer_accept_s", 0), config->GetInt("socket", "fast_open_queue", 0),
+      config->GetInt("socket", "rcvbuf", 0), config->GetInt("socket", "sndbuf", 0),
+      config->GetInt("socket", "busy_poll_Us", 0));
+  // Unix 域套接字：同机的反向代理可以不走回环 TCP，tcp = off 时只监听 Unix 域套接字
+  _listen_tcp = config->GetString("socket", "tcp", "on") == "on";
+  _listen_fd = -1;
+  _unix_listen_fd = -1;
+  _unix_path = config->GetString("socket", "unix_path", "");
+  _unix_mode = static_cast<int>(strtol(config->GetString("socket", "unix_mode", "660").c_str(), nullptr, 8));
+  HttpRequest::_max_header_bytes = config->GetInt("server", "max_header_bytes", 8192);
+  HttpRequest::_max_headers = config->GetInt("server", "max_headers", 64);
+  _inline_fast_path = config->GetString("server", "inline_fast_path", "off") == "on" ? true : false;
+  _inline_max_bytes = static_cast<size_t>(std::max(config->GetInt("server", "inline_max_bytes", 65536), 0));
 
   int thread_pool_size = config->GetInt("pool", "thread_pool_size", std::thread::hardware_concurrency()); // 没有配置的话默认系统核心数
   
-  _timer = new HeapTimer();
-  _thread_pool = new ThreadPool(thread_pool_size);
+  // 线程放置：绑定的 CPU 列表、调度策略
+  ThreadAffinity* affinity = ThreadAffinity::Instance();
+  std::string worker_cpus = config->GetString("affinity", "worker_cpus", "");
+  std::string reactor_cpus = config->GetString("affinity", "reactor_cpus", "");
+  std::string log_cpus = config->GetString("affinity", "log_cpus", "");
+  affinity->SetRole(ThreadAffinity::WORKER, worker_cpus,
+      config->GetString("affinity", "worker_sched", "other"), config->GetInt("affinity", "worker_sched_priority", 0));
+  affinity->SetRole(ThreadAffinity::REACTOR, reactor_cpus,
+      config->GetString("affinity", "reactor_sched", "other"), config->GetInt("affinity", "reactor_sched_priority", 0));
+  affinity->SetRole(ThreadAffinity::LOG, log_cpus,
+      config->GetString("affinity", "log_sched", "other"), config->GetInt("affinity", "log_sched_priority", 0));
+
+  // 时间轮精度：每个 tick 的毫秒数，连接超时按 tick 向上取整
+  int timer_tick_ms = config->GetInt("server", "timer_tick_ms", 10);
+  _timer = new TimingWheel(timer_tick_ms);
+  _timer->SetCallBack([this](TimerNode* node) {
+    HttpConnHot* hot = static_cast<HttpConnHot*>(node->data);
+    if (hot->is_close) return;
+    // 到期时才看连接所处阶段，期限没到（阶段变了或写出有进展）就按剩余时间重新计时
+    HttpConn* client = hot->conn;
+    HttpConn::CONN_PHASE phase = client->Phase();
+    int timeout = phase == HttpConn::IDLE ? IdleTimeout() : _phase_timeout_MS[phase];
+    int64_t left = client->PhaseStartMs() + timeout - CachedClock::MonoMs();
+    if (left > 0) {
+      _timer->add(node, static_cast<int>(std::min<int64_t>(left, _timer_check_MS)));
+      return;
+    }
+    // 超时关闭时工作线程可能还在处理该连接，不释放它的内存，留到连接复用时再用
+    if (phase == HttpConn::IDLE) {
+      CloseConn(client, false);
+    }
+    else {
+      // 请求没有按期收齐或响应写不出去：直接重置，尽快回收描述符
+      LOG_WARN_RATE(Log::Instance()->GetSiteRate(), "客户端[%d]阶段%d超时，重置连接", hot->fd, (int)phase);
+      ResetConn(client, false);
+    }
+  });
+  // 任务槽数量：EPOLLONESHOT 下每个连接同时最多一个任务，默认按最大连接数预分配
+  int task_slots = config->GetInt("pool", "task_slots", _max_fd);
+  _thread_pool = new ThreadPool(thread_pool_size, task_slots, [](size_t index) {
+    ThreadAffinity::Instance()->Apply(ThreadAffinity::WORKER, index);
+  });
+  int static_queue_limit = config->GetInt("pool", "static_queue_limit", 0);
+  _thread_pool->SetQueueLimit(static_queue_limit);
+  // 按排队时延卸载：排队过久的请求直接回复 503，不再占用工作线程
+  _thread_pool->SetCodel(config->GetInt("pool", "codel_target_Ms", 0), config->GetInt("pool", "codel_interval_Ms", 100));
+
+  // 数据库线程池：登录、注册请求单独排队，数据库变慢时不拖住静态资源请求
+  int db_pool_size = config->GetInt("pool", "db_pool_size", config->GetInt("pool", "mysql_connection_pool_size", 8));
+  int db_queue_limit = config->GetInt("pool", "db_queue_limit", 0);
+  _db_pool = new ThreadPool(db_pool_size, db_queue_limit > 0 ? db_queue_limit : task_slots, [thread_pool_size](size_t index) {
+    ThreadAffinity::Instance()->Apply(ThreadAffinity::WORKER, thread_pool_size + index);
+  });
+  _db_pool->SetQueueLimit(db_queue_limit);
+  _db_pool->SetCodel(config->GetInt("pool", "db_codel_target_Ms", 0), config->GetInt("pool", "db_codel_interval_Ms", 500));
   _epoller = new Epoller();
 
+  // 对象池：连接对象和缓冲区内存块，空闲对象先缓存在各线程，按批与中心交换
   int obj_pool_init_capacity = config->GetInt("pool", "_init_capacity", 1024);
   int obj_pool_increment = config->GetInt("pool", "_increment", 512); 
-  bool obj_pool_is_lock = config->GetString("pool", "_is_lock", "off") == "on" ? true : false;
-  _obj_pool = new ObjectPool<HttpConn>(obj_pool_init_capacity, obj_pool_increment, obj_pool_is_lock);
+  bool obj_pool_populate = config->GetString("pool", "_populate", "off") == "on" ? true : false;
+  int obj_pool_batch = config->GetInt("pool", "_batch", 32);
+  int buffer_chunks = config->GetInt("pool", "buffer_chunks", 2048);
+  _obj_pool = new ObjectPool<HttpConn>(obj_pool_init_capacity, obj_pool_increment, obj_pool_populate, obj_pool_batch);
+  BufferChunkPool::Instance()->Init(buffer_chunks, obj_pool_populate, obj_pool_batch);
+
+  // 连接热数据数组：按进程文件描述符上限预留，匿名映射用到哪页才分配哪页
+  struct rlimit nofile;
+  _conn_slots = 65536;
+  if (getrlimit(RLIMIT_NOFILE, &nofile) == 0 && nofile.rlim_cur != RLIM_INFINITY) {
+    _conn_slots = std::min<size_t>(nofile.rlim_cur, 1 << 22);
+  }
+  void* conns = mmap(nullptr, _conn_slots * sizeof(HttpConnHot), PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (conns == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  _conns = static_cast<HttpConnHot*>(conns);
 
   HttpConn::_user_count = 0;
   HttpConn::_src_dir = _src_root_dir;
 
+  // 用户存储后端：mysql（默认）或 embedded（进程内只追加日志）
+  std::string storage_backend = config->GetString("storage", "backend", "mysql");
+  std::string storage_path = config->GetString("storage", "embedded_path", "./users.db");
+  int storage_grow_mb = config->GetInt("storage", "embedded_grow_mb", 4);
+
   int mysql_connection_pool_size = config->GetInt("pool", "mysql_connection_pool_size", 8);
   std::string mysql_host = config->GetString("mysql", "mysql_host", "127.0.0.1");
   int mysql_port = config->GetInt("mysql", "mysql_port", 3306);
@@ -37,7 +153,22 @@ WebServer::WebServer() {
   std::string mysql_passwd = config->GetString("mysql", "mysql_passwd", "passwd");
   std::string mysql_databases = config->GetString("mysql", "mysql_databases", "databases");
 
-  SqlConnPool::Instance()->Init(mysql_host.c_str(), mysql_port, mysql_user.c_str(), mysql_passwd.c_str(), mysql_databases.c_str(), mysql_connection_pool_size);
+  bool register_batch = config->GetString("mysql", "register_batch", "off") == "on" ? true : false;
+  int register_batch_rows = config->GetInt("mysql", "register_batch_rows", 64);
+  int register_batch_wait_ms = config->GetInt("mysql", "register_batch_wait_ms", 5);
+
+  bool storage_ok = true;
+  if (storage_backend == "embedded") {
+    storage_ok = EmbeddedUserStore::Instance()->Open(storage_path, static_cast<size_t>(storage_grow_mb) * 1024 * 1024);
+    MysqlOpt::SetStore(EmbeddedUserStore::Instance());
+  }
+  else {
+    SqlConnPool::Instance()->Init(mysql_host.c_str(), mysql_port, mysql_user.c_str(), mysql_passwd.c_str(), mysql_databases.c_str(), mysql_connection_pool_size);
+    if (register_batch) {
+      RegisterBatcher::Instance()->Init(register_batch_rows, register_batch_wait_ms);
+    }
+    MysqlOpt::SetStore(MysqlUserStore::Instance());
+  }
   
   int tirg_mode = config->GetInt("server", "trig_mode", 3);
   _is_close = false;
@@ -52,36 +183,107 @@ WebServer::WebServer() {
     int log_que_size = config->GetInt("log", "log_que_size", 1024);
     int log_level = config->GetInt("log", "log_level", 1);
     int log_max_lines = config->GetInt("log", "log_max_lines", 40278);
-    Log::Instance()->init(log_level, log_path.c_str(), log_suffix.c_str(), log_que_size, log_max_lines);
+    int log_ring_kb = config->GetInt("log", "log_ring_kb", 256);
+    Log::OverflowPolicy log_overflow = config->GetString("log", "log_overflow", "drop") == "block" ? Log::OVERFLOW_BLOCK : Log::OVERFLOW_DROP;
+    // SCHED_IDLE 的刷盘线程在有负载时几乎拿不到 CPU，写日志的工作线程等它腾出空间会被一起拖住
+    std::string log_sched = config->GetString("affinity", "log_sched", "other");
+    bool log_block_idle = log_overflow == Log::OVERFLOW_BLOCK && log_sched == "idle";
+    if (log_block_idle) {
+      log_overflow = Log::OVERFLOW_DROP;
+    }
+    int log_flush_ms = config->GetInt("log", "log_flush_ms", 50);
+    bool log_binary = config->GetString("log", "log_format", "text") == "binary" ? true : false;
+    int log_site_rate = config->GetInt("log", "log_site_rate", 0);
+    Log::Instance()->SetSiteRate(log_site_rate);
+    Log::Instance()->init(log_level, log_path.c_str(), log_suffix.c_str(), log_que_size, log_max_lines,
+        log_ring_kb, log_overflow, log_flush_ms, log_binary);
     if (_is_close) {
       LOG_ERROR("========== 服务器初始化错误！==========");
     }
     else {
       LOG_INFO("========== 服务器初始化 ==========");
       if(!_load_conf_file_ok) LOG_WARN("配置文件加载失败!使用默认配置");
+      if (log_block_idle) LOG_WARN("日志线程调度策略为 idle，缓冲区写满策略 block 改为 drop");
       LOG_INFO("最大文件描述符个数：%d", _max_fd);
-      LOG_INFO("端口：%d，开启Linger：%s", _port, _open_linger ? "true" : "false");
+      LOG_INFO("端口：%d，开启Linger：%s", _listen_tcp ? _port : 0, _open_linger ? "true" : "false");
+      if (!_unix_path.empty()) LOG_INFO("Unix 域套接字：%s，权限：%o", _unix_path.c_str(), _unix_mode);
+      LOG_INFO("连接超时：%dms，时间轮精度：%dms", _timeout_MS, timer_tick_ms);
+      LOG_INFO("空闲超时：%dms，请求头超时：%dms，请求体超时：%dms，写超时：%dms，请求头上限：%zuB/%zu个",
+          _phase_timeout_MS[HttpConn::IDLE], _phase_timeout_MS[HttpConn::READ_HEADER], _phase_timeout_MS[HttpConn::READ_BODY],
+          _phase_timeout_MS[HttpConn::WRITE], HttpRequest::_max_header_bytes, HttpRequest::_max_headers);
+      LOG_INFO("每连接请求数上限：%d，空闲超时自适应：连接数超过%d后缩短到最小%dms",
+          HttpConn::_keep_alive_max, _idle_pressure_users, _idle_min_timeout_MS);
+      LOG_INFO("准入控制：单IP连接数上限：%d，单IP请求速率：%d/s，新建连接速率：%d/s（0 不限）", per_ip_conns, per_ip_rate, conn_rate);
+      LOG_INFO("主循环直接处理静态请求：%s，文件大小上限：%zuB", _inline_fast_path ? "true" : "false", _inline_max_bytes);
       
       LOG_INFO("监听模式：%s，连接模式：%s",
           (_listen_event & EPOLLET ? "ET" : "LT"),
           (_conn_event & EPOLLET ? "ET" : "LT"));
-      LOG_INFO("日志等级：%d", log_level);
+      LOG_INFO("日志等级：%d，每线程缓冲：%dKB，写满策略：%s，刷盘间隔：%dms，延迟格式化：%s", log_level, log_ring_kb,
+          log_overflow == Log::OVERFLOW_DROP ? "drop" : "block", log_flush_ms, Log::Instance()->IsBinary() ? "true" : "false");
+      LOG_INFO("连接类日志每个调用点每秒最多：%d 行（0 不限），编译期最低等级：%d", log_site_rate, LOG_MIN_LEVEL);
       LOG_INFO("资源路径：%s", HttpConn::_src_dir);
-      LOG_INFO("Sql连接池数量：%d，线程池数量：%d", mysql_connection_pool_size, thread_pool_size);
-      LOG_INFO("对象连接池初始数量：%d，起始扩容数量：%d，访问加锁：%s",  obj_pool_init_capacity,  obj_pool_increment,  obj_pool_is_lock ? "true" : "false");
+      LOG_INFO("用户存储：%s", storage_backend.c_str());
+      if (storage_backend == "embedded") {
+        LOG_INFO("用户存储文件：%s，每次扩容：%dMB", storage_path.c_str(), storage_grow_mb);
+        if (!storage_ok) LOG_ERROR("用户存储打开失败，登录注册将不可用！");
+      }
+      else {
+        LOG_INFO("Sql连接池数量：%d", mysql_connection_pool_size);
+        LOG_INFO("注册写合并：%s，每批最大行数：%d，最长等待：%dms", register_batch ? "true" : "false", register_batch_rows, register_batch_wait_ms);
+      }
+      LOG_INFO("线程池数量：%d，任务槽数量：%d，排队上限：%d", thread_pool_size, task_slots, static_queue_limit);
+      LOG_INFO("数据库线程池数量：%d，排队上限：%d", db_pool_size, db_queue_limit);
+      LOG_INFO("绑核：工作线程[%s]，主循环[%s]，日志线程[%s]",
+          worker_cpus.c_str(), reactor_cpus.c_str(), log_cpus.c_str());
+      LOG_INFO("对象连接池初始数量：%d，起始扩容数量：%d，预先映射：%s，线程缓存每批：%d",  obj_pool_init_capacity,  obj_pool_increment,  obj_pool_populate ? "true" : "false", obj_pool_batch);
+      LOG_INFO("缓冲区内存块预分配：%d 块（每块 %dB）", buffer_chunks, (int)sizeof(BufferChunk));
+    }
+  }
+
+  // 访问日志：独立文件，批量写入，按大小改名切分，切分出的文件后台压缩
+  bool access_log = config->GetString("access_log", "access_log", "off") == "on" ? true : false;
+  std::string access_log_path = config->GetString("access_log", "access_log_path", "./access.log");
+  int access_log_max_mb = config->GetInt("access_log", "access_log_max_mb", 64);
+  int access_log_flush_ms = config->GetInt("access_log", "access_log_flush_ms", 200);
+  std::string access_log_compress = config->GetString("access_log", "access_log_compress", "gzip");
+  int access_log_ring_kb = config->GetInt("access_log", "access_log_ring_kb", 256);
+  bool access_log_ok = true;
+  if (access_log) {
+    access_log_ok = AccessLog::Instance()->Open(access_log_path, static_cast<size_t>(access_log_max_mb) * 1024 * 1024,
+        access_log_flush_ms, access_log_compress, static_cast<size_t>(access_log_ring_kb) * 1024);
+    if (!_is_close) {
+      LOG_INFO("访问日志：%s，切分大小：%dMB，压缩：%s", access_log_path.c_str(), access_log_max_mb, access_log_compress.c_str());
+      if (!access_log_ok) LOG_ERROR("访问日志打开失败！");
     }
   }
 }
 
 
 WebServer::~WebServer() {
-    close(_listen_fd);
+    if (_listen_fd >= 0) close(_listen_fd);
+    if (_unix_listen_fd >= 0) {
+        close(_unix_listen_fd);
+        unlink(_unix_path.c_str());
+    }
     _is_close = true;
     delete _src_root_dir;
     delete _timer;
     delete _thread_pool;
+    delete _db_pool;
     delete _epoller;
+    // 线程池已停止，连接对象还给对象池
+    for (size_t i = 0; i < _conn_slots; i++) {
+        if (_conns[i].conn) {
+            _obj_pool->Delete(_conns[i].conn);
+        }
+    }
+    munmap(_conns, _conn_slots * sizeof(HttpConnHot));
+    delete _obj_pool;
+    RegisterBatcher::Instance()->Close();
+    AccessLog::Instance()->Close();
     SqlConnPool::Instance()->ClosePool();
+    EmbeddedUserStore::Instance()->Close();
 }
 
 // 初始化事件模式
@@ -111,32 +313,34 @@ void WebServer::InitEventMode(int trigMode) {
 
 // 启动服务器
 void WebServer::Start() {
-    int timeMS = -1;  // epoll等待超时时间，-1表示无事件将一直阻塞
+    int timeMS = -1;  // epoll等待超时时间，-1表示无事件将一直阻塞；超时由 timerfd 唤醒
+    ThreadAffinity::Instance()->Apply(ThreadAffinity::REACTOR);
     if (!_is_close) { LOG_INFO("========== 服务器启动 =========="); }
     while (!_is_close) {
-        if (_timeout_MS > 0) {
-            timeMS = _timer->GetNextTick();
-        }
-
         int eventCnt = _epoller->Wait(timeMS);  // 等待事件发生
+        CachedClock::Update();  // 每轮刷新一次缓存时钟，本轮的定时器、日志、响应头都用这个时间
         for (int i = 0; i < eventCnt; i++) {
             int fd = _epoller->GetEventFd(i);  // 获取事件的文件描述符
             uint32_t events = _epoller->GetEvents(i);  // 获取事件类型
-            if (fd == _listen_fd) {
-                DealListen();  // 处理监听事件
+            if (fd == _listen_fd || fd == _unix_listen_fd) {
+                DealListen(fd);  // 处理监听事件
+            }
+            else if (fd == _timer->Fd()) {
+                _timer->tick();  // 处理到期的连接
             }
             else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
                 // 处理套接字关闭、挂起或错误的情况
-                assert(_users.count(fd) > 0);
-                CloseConn(&_users[fd]);  // 关闭连接
+                assert(static_cast<size_t>(fd) < _conn_slots && _conns[fd].conn);
+                _timer->del(&_conns[fd].timer);
+                CloseConn(_conns[fd].conn);  // 关闭连接
             }
             else if (events & EPOLLIN) {
-                assert(_users.count(fd) > 0);
-                DealRead(&_users[fd]);  // 处理读事件
+                assert(static_cast<size_t>(fd) < _conn_slots && _conns[fd].conn);
+                DealRead(&_conns[fd]);  // 处理读事件
             }
             else if (events & EPOLLOUT) {
-                assert(_users.count(fd) > 0);
-                DealWrite(&_users[fd]);  // 处理写事件
+                assert(static_cast<size_t>(fd) < _conn_slots && _conns[fd].conn);
+                DealWrite(&_conns[fd]);  // 处理写事件
             }
             else {
                 LOG_ERROR("未知的事件类型");
@@ -145,81 +349,136 @@ void WebServer::Start() {
     }
 }
 
-// 发送错误信息给客户端
-void WebServer::SendError(int fd, const char* info) {
-    assert(fd > 0);
-    int ret = send(fd, info, strlen(info), 0);
-    if (ret < 0) {
-        LOG_WARN("向客户端[%d]发送错误信息失败！", fd);
-    }
-    close(fd);
-}
-
 // 关闭连接
-void WebServer::CloseConn(HttpConn* client) {
+void WebServer::CloseConn(HttpConn* client, bool releaseMemory) {
     assert(client);
-    LOG_INFO("客户端[%d]断开连接！", client->GetFd());
+    LOG_INFO_RATE(Log::Instance()->GetSiteRate(), "客户端[%d]断开连接！占用内存：%zuB", client->GetFd(), client->MemoryBytes());
     _epoller->DelFd(client->GetFd());  // 从epoll中移除
     client->Close();  // 关闭连接
-    //_obj_pool->Delete(client);
-    //auto it = _users.find(client->GetFd());
-
-    //bug _users.erase会再次析构client,Delete已经回收过了
-    //if(it != _users.end()) _users.erase(it);
-    /*
-    if(it != _users.end()) {
-      _users[client->GetFd()] = nullptr;
-      _users.erase(it);
-    }*/
+    if (releaseMemory) {
+        client->ReleaseMemory();  // 连接对象按 fd 保留复用，内存块先还给块池
+    }
+}
+
+// 空闲超时随连接数自适应：连接数超过压力线后，从配置值线性缩短到最小值
+int WebServer::IdleTimeout() const {
+    int idle = _phase_timeout_MS[HttpConn::IDLE];
+    int users = HttpConn::_user_count;
+    if (users <= _idle_pressure_users || idle <= _idle_min_timeout_MS) {
+        return idle;
+    }
+    int range = std::max(_max_fd - _idle_pressure_users, 1);
+    int over = std::min(users - _idle_pressure_users, range);
+    return idle - static_cast<int>(static_cast<int64_t>(idle - _idle_min_timeout_MS) * over / range);
+}
+
+// 关闭最老的一个空闲连接：连接已满时不看空闲时长，否则只关闭空闲超过自适应超时的
+void WebServer::EvictIdle(bool force) {
+    int64_t idleBefore = force ? INT64_MAX : CachedClock::MonoMs() - IdleTimeout();
+    HttpConn* idle = HttpConn::PopIdle(idleBefore);
+    if (idle) {
+        LOG_INFO_RATE(Log::Instance()->GetSiteRate(), "连接数%d，关闭最老的空闲连接[%d]", (int)HttpConn::_user_count, idle->GetFd());
+        _timer->del(&idle->GetHot()->timer);
+        CloseConn(idle, false);  // 空闲连接的内存已经归还
+    }
+}
+
+// 重置连接：SO_LINGER 超时设为 0，close 时直接发 RST，不经过 FIN 和 TIME_WAIT
+void WebServer::ResetConn(HttpConn* client, bool releaseMemory) {
+    assert(client);
+    if (!client->GetHot()->is_close) {
+        struct linger optLinger = { 1, 0 };
+        setsockopt(client->GetFd(), SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    }
+    CloseConn(client, releaseMemory);
 }
 
 // 添加客户端连接
-void WebServer::AddClient(int fd, sockaddr_in addr) {
-    assert(fd > 0);
-    //_users[fd] = _obj_pool->New();
-    _users[fd].init(fd, addr);
+void WebServer::AddClient(int fd, sockaddr_in addr, bool connCounted) {
+    assert(fd > 0 && static_cast<size_t>(fd) < _conn_slots);
+    // 连接对象从对象池分配，按 fd 复用：关闭后工作线程里可能还有该连接的任务，对象不立即归还
+    // 映射的内存全为 0，conn 为空表示该槽还没用过
+    HttpConnHot* hot = &_conns[fd];
+    if (hot->conn == nullptr) {
+        new (hot) HttpConnHot();
+        hot->conn = _obj_pool->New();
+    }
+    HttpConn* client = hot->conn;
+    client->init(hot, fd, addr, connCounted);
     if (_timeout_MS > 0) {
-        _timer->add(fd, _timeout_MS, std::bind(&WebServer::CloseConn, this, &_users[fd]));
+        _timer->add(&hot->timer, std::min(_phase_timeout_MS[HttpConn::READ_HEADER], _timer_check_MS));
     }
     _epoller->AddFd(fd, EPOLLIN | _conn_event);  // 将客户端加入epoll监听
-    SetFdNonblock(fd);  // 设置文件描述符为非阻塞模式
-    LOG_INFO("客户端[%d]连接！", _users[fd].GetFd());
+    LOG_INFO_RATE(Log::Instance()->GetSiteRate(), "客户端[%d]连接！连接数：%d，缓冲区内存块：%zu",
+        client->GetFd(), (int)HttpConn::_user_count, BufferChunkPool::Instance()->Total());
 }
 
 // 处理监听事件
-void WebServer::DealListen() {
+void WebServer::DealListen(int listenFd) {
     struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
+    socklen_t len;
+    const bool isUnix = listenFd == _unix_listen_fd;
     do {
-        int fd = accept(_listen_fd, (struct sockaddr*)&addr, &len);  // 接受连接请求
+        // 接受连接请求，直接得到非阻塞、exec 时关闭的套接字，不再另调 fcntl
+        int fd;
+        if (isUnix) {
+            // Unix 域连接没有对端地址：地址族记为 AF_UNIX，IP 为 0，不参与单 IP 限制
+            fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_UNIX;
+        }
+        else {
+            len = sizeof(addr);
+            fd = accept4(listenFd, (struct sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        }
         if (fd <= 0) { return; }
-        else if (HttpConn::_user_count >= _max_fd) {
-            SendError(fd, "服务器繁忙！");
-            LOG_WARN("客户端已满！");
-            return;
+        if (HttpConn::_user_count >= _idle_pressure_users) {
+            EvictIdle(HttpConn::_user_count >= _max_fd);  // 连接数接近上限，腾出最老的空闲连接
+        }
+        // 超限时回复 503 后关闭，继续接受队列里的其他连接
+        Admission* admission = Admission::Instance();
+        if (HttpConn::_user_count >= _max_fd || static_cast<size_t>(fd) >= _conn_slots) {
+            admission->Reject(fd);
+            LOG_WARN_RATE(Log::Instance()->GetSiteRate(), "客户端已满！");
+            continue;
         }
-        AddClient(fd, addr);  // 添加新客户端连接
+        bool counted = false;
+        if (!admission->AcquireConn(addr.sin_addr.s_addr, &counted)) {
+            admission->Reject(fd);
+            LOG_WARN_RATE(Log::Instance()->GetSiteRate(), "客户端%s超过连接数或新建连接速率限制，已拒绝%llu次",
+                isUnix ? "unix" : inet_ntoa(addr.sin_addr), static_cast<unsigned long long>(admission->Rejected()));
+            continue;
+        }
+        AddClient(fd, addr, counted);  // 添加新客户端连接
     } while (_listen_event & EPOLLET);  // 是否启用边缘触发模式
 }
 
 // 处理读事件
-void WebServer::DealRead(HttpConn* client) {
-    assert(client);
-    ExtenTime(client);  // 更新连接的超时时间
-    _thread_pool->AddTask(std::bind(&WebServer::OnRead, this, client));  // 将读事件添加到线程池
+void WebServer::DealRead(HttpConnHot* hot) {
+    assert(hot && hot->conn);
+    HttpConn* client = hot->conn;
+    if (_inline_fast_path) {
+        OnReadInline(client);  // 在主循环线程直接处理
+        return;
+    }
+    // 将读事件添加到线程池，排队已满时关闭连接
+    if (!Submit(_thread_pool, client, &WebServer::OnRead)) {
+        LOG_WARN_RATE(Log::Instance()->GetSiteRate(), "线程池排队已满，关闭客户端[%d]", client->GetFd());
+        _timer->del(&hot->timer);
+        CloseConn(client);
+    }
 }
 
 // 处理写事件
-void WebServer::DealWrite(HttpConn* client) {
-    assert(client);
-    ExtenTime(client);  // 更新连接的超时时间
-    _thread_pool->AddTask(std::bind(&WebServer::OnWrite, this, client));  // 将写事件添加到线程池
-}
-
-// 延长连接的超时时间
-void WebServer::ExtenTime(HttpConn* client) {
-    assert(client);
-    if (_timeout_MS > 0) { _timer->adjust(client->GetFd(), _timeout_MS); }
+void WebServer::DealWrite(HttpConnHot* hot) {
+    assert(hot && hot->conn);
+    HttpConn* client = hot->conn;
+    // 将写事件添加到线程池，排队已满时关闭连接
+    if (!Submit(_thread_pool, client, &WebServer::OnWrite)) {
+        LOG_WARN_RATE(Log::Instance()->GetSiteRate(), "线程池排队已满，关闭客户端[%d]", client->GetFd());
+        _timer->del(&hot->timer);
+        CloseConn(client);
+    }
 }
 
 // 处理读事件
@@ -232,7 +491,95 @@ void WebServer::OnRead(HttpConn* client) {
         CloseConn(client);  // 关闭连接
         return;
     }
-    OnProcess(client);  // 处理请求
+    DispatchProcess(client);  // 处理请求
+}
+
+// 在主循环线程处理读事件：读取、解析、响应、写回一次完成，省去交给线程池再唤醒的开销
+// 只处理已在页缓存中的小静态文件，其余请求（数据库路由、大文件、冷文件、错误页）和一次没写完的响应交给线程池
+void WebServer::OnReadInline(HttpConn* client) {
+    assert(client);
+    int readErrno = 0;
+    int ret = client->read(&readErrno);
+    if (ret <= 0 && readErrno != EAGAIN) {
+        CloseConn(client);
+        return;
+    }
+    ProcessInline(client);
+}
+
+// 不经过 OnWrite：OnWrite 写完后直接处理下一个请求，流水线上的后续请求会绕过判断在主循环读盘
+void WebServer::ProcessInline(HttpConn* client) {
+    while (true) {
+        if (client->IsDbRequest()) {
+            DispatchProcess(client);  // 交给数据库线程池
+            return;
+        }
+        if (client->HasReadData() && !client->IsCachedStatic(_inline_max_bytes)) {
+            // 处理时可能读盘，交给线程池，排队已满时关闭连接
+            if (!Submit(_thread_pool, client, &WebServer::OnProcess)) {
+                LOG_WARN_RATE(Log::Instance()->GetSiteRate(), "线程池排队已满，关闭客户端[%d]", client->GetFd());
+                _timer->del(&client->GetHot()->timer);
+                CloseConn(client);
+            }
+            return;
+        }
+        // 读缓冲区为空时 process 只让连接进入空闲，不读盘
+        if (!client->process()) {
+            if (client->IsAborted()) {
+                ResetConn(client);  // 请求头超限
+                return;
+            }
+            _epoller->ModFd(client->GetFd(), _conn_event | EPOLLIN);  // 请求不完整或连接空闲，继续等待读事件
+            return;
+        }
+        int writeErrno = 0;
+        ssize_t ret = client->write(&writeErrno);
+        if (client->ToWriteBytes() > 0) {
+            if (ret < 0 && writeErrno == EAGAIN) {
+                _epoller->ModFd(client->GetFd(), _conn_event | EPOLLOUT);  // 写不完，之后的写事件由线程池处理
+                return;
+            }
+            CloseConn(client);
+            return;
+        }
+        client->LogAccess();
+        if (!client->IsKeepAlive()) {
+            CloseConn(client);
+            return;
+        }
+    }
+}
+
+// 按路由分流：登录、注册交给数据库线程池，其余在当前线程处理
+void WebServer::DispatchProcess(HttpConn* client) {
+    if (client->IsDbRequest()) {
+        if (!Submit(_db_pool, client, &WebServer::OnProcess)) {
+            LOG_WARN_RATE(Log::Instance()->GetSiteRate(), "数据库线程池排队已满，关闭客户端[%d]", client->GetFd());
+            CloseConn(client);
+        }
+        return;
+    }
+    OnProcess(client);
+}
+
+// 任务开始时比较代数：排队期间连接被关闭（客户端断开、超时、空闲淘汰）的任务不再读写和访问数据库；
+// 任务持有引用期间描述符不关闭，工作线程不会写到被新连接复用的描述符上
+bool WebServer::Submit(ThreadPool* pool, HttpConn* client, void (WebServer::*handler)(HttpConn*)) {
+    uint32_t gen = client->Gen();
+    if (client->IsClosed()) {
+        return true;  // 已经关闭（关闭时先置标志再加代数，所以先取代数再看标志不会漏掉）
+    }
+    client->Ref();
+    bool added = pool->AddTask([this, client, gen, handler] {
+        if (!client->IsStale(gen)) {
+            (this->*handler)(client);
+        }
+        client->Unref();
+    });
+    if (!added) {
+        client->Unref();
+    }
+    return added;
 }
 
 // 处理请求
@@ -240,6 +587,9 @@ void WebServer::OnProcess(HttpConn* client) {
     if (client->process()) {
         _epoller->ModFd(client->GetFd(), _conn_event | EPOLLOUT);  // 修改事件类型为写事件
     }
+    else if (client->IsAborted()) {
+        ResetConn(client);  // 请求头超限，直接重置
+    }
     else {
         _epoller->ModFd(client->GetFd(), _conn_event | EPOLLIN);  // 修改事件类型为读事件
     }
@@ -253,8 +603,9 @@ void WebServer::OnWrite(HttpConn* client) {
     ret = client->write(&writeErrno);  // 写数据
     if (client->ToWriteBytes() == 0) {
         // 数据传输完成
+        client->LogAccess();
         if (client->IsKeepAlive()) {
-            OnProcess(client);  // 继续处理请求
+            DispatchProcess(client);  // 继续处理请求
             return;
         }
     }
@@ -270,6 +621,32 @@ void WebServer::OnWrite(HttpConn* client) {
 
 // 初始化套接字
 bool WebServer::InitSocket() {
+    if (!_listen_tcp && _unix_path.empty()) {
+        LOG_ERROR("TCP 端口和 Unix 域套接字都没有启用！");
+        return false;
+    }
+    if (_listen_tcp && !InitTcpSocket()) {
+        return false;
+    }
+    if (!_unix_path.empty() && !InitUnixSocket()) {
+        if (_listen_fd >= 0) {
+            close(_listen_fd);
+            _listen_fd = -1;
+        }
+        return false;
+    }
+    if (_timeout_MS > 0) {
+        int ret = _epoller->AddFd(_timer->Fd(), EPOLLIN);  // 时间轮的 timerfd 加入epoll监听（水平触发）
+        if (ret == 0) {
+            LOG_ERROR("添加定时器监听失败！");
+            return false;
+        }
+    }
+    return true;
+}
+
+// 初始化 TCP 监听套接字
+bool WebServer::InitTcpSocket() {
     int ret;
     struct sockaddr_in addr;
     if (_port > 65535 || _port < 1024) {
@@ -286,7 +663,7 @@ bool WebServer::InitSocket() {
         optLinger.l_linger = 1;     // 延迟关闭的时间，以秒为单位
     }
 
-    _listen_fd = socket(AF_INET, SOCK_STREAM, 0);  // 创建套接字
+    _listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);  // 创建非阻塞套接字
     if (_listen_fd < 0) {
         LOG_ERROR("创建套接字失败！", _port);
         return false;
@@ -307,6 +684,9 @@ bool WebServer::InitSocket() {
         return false;
     }
 
+    SocketTuning* tuning = SocketTuning::Instance();
+    tuning->ApplyListen(_listen_fd);  // 连接套接字继承监听套接字的选项
+
     ret = bind(_listen_fd, (struct sockaddr*)&addr, sizeof(addr));  // 绑定地址
     if (ret < 0) {
         LOG_ERROR("绑定端口：%d 失败！", _port);
@@ -314,7 +694,7 @@ bool WebServer::InitSocket() {
         return false;
     }
 
-    ret = listen(_listen_fd, 6);  // 开始监听，最大排队数为6
+    ret = listen(_listen_fd, tuning->Backlog());  // 开始监听
     if (ret < 0) {
         LOG_ERROR("监听端口：%d 失败！", _port);
         close(_listen_fd);
@@ -326,14 +706,52 @@ bool WebServer::InitSocket() {
         close(_listen_fd);
         return false;
     }
-    SetFdNonblock(_listen_fd);  // 设置文件描述符为非阻塞模式
     LOG_INFO("服务器端口：%d", _port);
     return true;
 }
 
-// 设置文件描述符为非阻塞模式
-int WebServer::SetFdNonblock(int fd) {
-    assert(fd > 0);
-    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);
+// 初始化 Unix 域监听套接字
+bool WebServer::InitUnixSocket() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (_unix_path.size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Unix 域套接字路径过长：%s", _unix_path.c_str());
+        return false;
+    }
+    memcpy(addr.sun_path, _unix_path.c_str(), _unix_path.size());
+
+    // 上次运行留下的套接字文件会让 bind 失败，只删除套接字类型的文件，避免误删配置错的普通文件
+    struct stat st;
+    if (lstat(_unix_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(_unix_path.c_str());
+    }
+
+    _unix_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_unix_listen_fd < 0) {
+        LOG_ERROR("创建 Unix 域套接字失败！");
+        return false;
+    }
+    // TCP 选项对 Unix 域套接字无意义，只沿用监听队列长度
+    if (bind(_unix_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        LOG_ERROR("绑定 Unix 域套接字：%s 失败：%s", _unix_path.c_str(), strerror(errno));
+        close(_unix_listen_fd);
+        _unix_listen_fd = -1;
+        return false;
+    }
+    // 连接需要对套接字文件有写权限，由权限控制哪些用户（反向代理）可以连接
+    if (chmod(_unix_path.c_str(), _unix_mode) < 0) {
+        LOG_WARN("设置 Unix 域套接字权限失败：%s", strerror(errno));
+    }
+    if (listen(_unix_listen_fd, SocketTuning::Instance()->Backlog()) < 0
+        || _epoller->AddFd(_unix_listen_fd, _listen_event | EPOLLIN) == 0) {
+        LOG_ERROR("监听 Unix 域套接字：%s 失败！", _unix_path.c_str());
+        close(_unix_listen_fd);
+        _unix_listen_fd = -1;
+        unlink(_unix_path.c_str());
+        return false;
+    }
+    LOG_INFO("服务器 Unix 域套接字：%s", _unix_path.c_str());
+    return true;
 }
 
@@ -0,0 +1,123 @@
+// 分配次数测试：keep-alive 连接上的静态文件请求进入稳定状态后，每个请求不应再调用 malloc
+// 缓冲区从 BufferChunkPool 取，请求级内存走 RequestArena，这里统计稳定后若干请求内的全局分配次数
+// 用法：alloc_test [请求数=1000]，有分配时返回非 0
+#include "httpconnection.h"
+
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+
+static bool g_counting = false;
+static size_t g_allocs = 0;
+
+// 替换全局分配函数（operator new 也经过 malloc），只在统计区间内计数
+extern "C" void* malloc(size_t size) {
+    if (g_counting) g_allocs++;
+    return __libc_malloc(size);
+}
+extern "C" void* calloc(size_t n, size_t size) {
+    if (g_counting) g_allocs++;
+    return __libc_calloc(n, size);
+}
+extern "C" void* realloc(void* ptr, size_t size) {
+    if (g_counting) g_allocs++;
+    return __libc_realloc(ptr, size);
+}
+extern "C" int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    if (g_counting) g_allocs++;
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+static const char REQUEST[] = "GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n";
+
+// 按主循环的顺序处理一个请求：读、处理、写完后再处理一次（没有后续请求，连接进入空闲并归还内存）
+// peer 端读走全部响应，返回响应是否为 200
+static bool RoundTrip(HttpConn* conn, int peer) {
+    static char resp[65536];
+    if (::write(peer, REQUEST, sizeof(REQUEST) - 1) != (ssize_t)sizeof(REQUEST) - 1) return false;
+    int err = 0;
+    if (conn->read(&err) <= 0 || !conn->process()) return false;
+    size_t total = conn->ToWriteBytes();
+    size_t got = 0;
+    bool ok = false;
+    while (conn->ToWriteBytes() > 0) {
+        if (conn->write(&err) < 0 && err != EAGAIN) return false;
+        ssize_t len = ::read(peer, resp, sizeof(resp));
+        if (len <= 0) return false;
+        if (got == 0) ok = (len >= 12 && memcmp(resp, "HTTP/1.1 200", 12) == 0);
+        got += len;
+    }
+    while (got < total) {
+        ssize_t len = ::read(peer, resp, sizeof(resp));
+        if (len <= 0) return false;
+        got += len;
+    }
+    conn->LogAccess();
+    conn->process();
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const int requests = argc > 1 ? atoi(argv[1]) : 1000;
+
+    // 临时站点目录，放一个小文件
+    char root[] = "/tmp/alloc_test_XXXXXX";
+    if (mkdtemp(root) == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string srcDir = std::string(root) + "/";
+    std::string file = srcDir + "index.html";
+    FILE* fp = fopen(file.c_str(), "w");
+    if (fp == nullptr) {
+        perror("fopen");
+        return 1;
+    }
+    fputs("<html><body>alloc test</body></html>\n", fp);
+    fclose(fp);
+    HttpConn::_src_dir = srcDir.c_str();
+    HttpConn::_is_ET = false;
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("socketpair");
+        return 1;
+    }
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_UNIX;
+    HttpConnHot hot;
+    HttpConn* conn = new HttpConn();
+    conn->init(&hot, fds[0], addr);
+
+    // 预热：内存池、线程缓存、文件类型表等首次使用时的分配不计入
+    int failed = 0;
+    for (int i = 0; i < 16; i++) {
+        if (!RoundTrip(conn, fds[1])) failed++;
+    }
+    g_counting = true;
+    for (int i = 0; i < requests; i++) {
+        if (!RoundTrip(conn, fds[1])) failed++;
+    }
+    g_counting = false;
+
+    conn->Close();
+    delete conn;
+    close(fds[1]);
+    unlink(file.c_str());
+    rmdir(root);
+
+    printf("请求数：%d，失败：%d，稳定后分配次数：%zu（%.3f 次/请求）\n",
+        requests, failed, g_allocs, requests > 0 ? (double)g_allocs / requests : 0.0);
+    return (failed == 0 && g_allocs == 0) ? 0 : 1;
+}